@@ -6,6 +6,10 @@
 #include <assert.h>
 #include "NNRobot.h"
 #include "triangulation.h"
+#include "perf_counters.h"
+#include "trace.h"
+#include "parallel.h"
+#include "hash.h"
 
 #define min(a,b) a < b ? a : b
 
@@ -15,6 +19,7 @@
 std::vector<unsigned int> NNRobot::hidden_sizes = std::vector<unsigned int>{25,25};
 
 std::vector<Mass> NNRobot::randMasses;
+Eigen::MatrixXf NNRobot::randInput;
 bool NNRobot::randMassesFilled = false;
 
 unsigned int NNRobot::num_layers = 4;
@@ -25,6 +30,12 @@ unsigned int NNRobot::maxMasses = 1708;
 unsigned int NNRobot::maxSprings = NNRobot::maxMasses * NNRobot::springs_per_mass;
 CrossoverDistribution NNRobot::crossover_distribution = CROSS_DIST_BINOMIAL;
 CrossoverType NNRobot::crossover_type = CROSS_CONTIGUOUS;
+AlphaMode NNRobot::alpha_mode = ALPHA_OPTIMAL;
+float NNRobot::alpha = 4.0f;
+std::atomic<float> NNRobot::cached_alpha(-1.0f);
+MeshType NNRobot::mesh_type = MESH_ALPHA;
+float NNRobot::lattice_spacing = 0.0f;
+Config::NNRobot::Screen NNRobot::screen_options = Config::NNRobot::Screen();
 
 void ShiftY(NNRobot& R) {
     bool setFlag = false;
@@ -90,7 +101,7 @@ void NNRobot::Mutate() {
 }
 
 CandidatePair<NNRobot> NNRobot::Crossover(const CandidatePair<NNRobot>& parents) {
-    CandidatePair<NNRobot> children;
+    CandidatePair<NNRobot> children = {parents.first.CloneGenome(), parents.second.CloneGenome()};
     int crossover_count, layer = 0;
 
     switch(crossover_type)
@@ -173,7 +184,17 @@ float NNRobot::Distance(const CandidatePair<NNRobot>& candidates) {
     return distance;
 }
 
-std::vector<float> NNRobot::findDiversity(std::vector<NNRobot> pop) {
+uint64_t NNRobot::GenomeHash() const {
+    uint64_t hash = 0;
+    for(const Eigen::MatrixXf& W : weights) {
+        uint64_t shape[2] = {(uint64_t) W.rows(), (uint64_t) W.cols()};
+        hash = util::HashBytes(shape, sizeof(shape), hash);
+        hash = util::HashBytes(W.data(), W.size() * sizeof(float), hash);
+    }
+    return hash;
+}
+
+std::vector<float> NNRobot::findDiversity(const std::vector<NNRobot>& pop) {
     size_t pop_size = pop.size();
     std::vector<float> diversity(pop_size, 0);
     
@@ -187,29 +208,232 @@ std::vector<float> NNRobot::findDiversity(std::vector<NNRobot> pop) {
     return diversity;
 }
 
-void BuildSubset(std::vector<NNRobot>& robots, size_t begin, size_t end) {
-    for(uint i = begin; i < end; i++) {
-        robots[i].Build();
+void NNRobot::BatchForward(std::vector<NNRobot>& robots, size_t begin, size_t end, ForwardWorkspace& ws) {
+    if(begin >= end) return;
+    std::vector<NNRobot*> batch;
+    for(size_t r = begin; r < end; r++) batch.push_back(&robots[r]);
+    forwardBlocked(batch.data(), batch.size(), ws);
+}
+
+void NNRobot::forward() {
+    static thread_local ForwardWorkspace ws;
+    NNRobot* self = this;
+    forwardBlocked(&self, 1, ws);
+}
+
+void NNRobot::ReferenceForward() {
+    if(!randMassesFilled) fillRandMasses(maxMasses);
+    masses = randMasses;
+
+    Eigen::MatrixXf x(input_size, masses.size());
+    for(size_t i = 0; i < masses.size(); i++) {
+        x.col(i) = masses[i].protoPos;
+    }
+
+    for(unsigned int i = 0; i < num_layers-2; i++) {
+        x = relu(weights[i] * x);
+    }
+    x = weights[num_layers-2] * x;
+
+    float maxNorm = 0.0f;
+    for(int i = 0; i < x.cols(); ++i) {
+        float norm = x.col(i).head(output_size - MATERIAL_COUNT).norm();
+        if(maxNorm < norm) maxNorm = norm;
+    }
+    Eigen::MatrixXf material_probs = softmax(x.bottomRows(MATERIAL_COUNT));
+
+    for(uint i = 0; i < masses.size(); i++) {
+        masses[i].pos = masses[i].protoPos = 10 * x.col(i).head(output_size - MATERIAL_COUNT) / maxNorm;
+
+        int maxIdx;
+        material_probs.col(i).maxCoeff(&maxIdx);
+        masses[i].material = materials::matLookup(maxIdx);
+    }
+}
+
+void NNRobot::forwardBlocked(NNRobot* const* robots, size_t count, ForwardWorkspace& ws) {
+    TRACE_SCOPE("BatchForward", "build");
+    PERF_SCOPE("nn.forward", 0);
+    if(!randMassesFilled) fillRandMasses(maxMasses);
+
+    const Eigen::Index N = randInput.cols();
+    const size_t hidden_layers = robots[0]->weights.size() - 1;
+
+    // resize is a no-op when the workspace already has the right shape
+    ws.activations.resize(hidden_layers);
+    for(size_t l = 0; l < hidden_layers; l++) {
+        ws.activations[l].resize(robots[0]->weights[l].rows(), forward_block_size);
+    }
+    if(ws.outputs.size() < count) ws.outputs.resize(count);
+    for(size_t r = 0; r < count; r++) {
+        ws.outputs[r].resize(output_size, N);
+    }
+
+    // Block outer, robot inner: each input block is reused by every robot
+    for(Eigen::Index c = 0; c < N; c += forward_block_size) {
+        const Eigen::Index bc = std::min<Eigen::Index>(forward_block_size, N - c);
+        const auto input = randInput.middleCols(c, bc);
+
+        for(size_t r = 0; r < count; r++) {
+            const std::vector<Eigen::MatrixXf>& W = robots[r]->weights;
+
+            ws.activations[0].leftCols(bc).noalias() = W[0] * input;
+            ws.activations[0].leftCols(bc) = ws.activations[0].leftCols(bc).cwiseMax(0.0f);
+            for(size_t l = 1; l < hidden_layers; l++) {
+                ws.activations[l].leftCols(bc).noalias() = W[l] * ws.activations[l-1].leftCols(bc);
+                ws.activations[l].leftCols(bc) = ws.activations[l].leftCols(bc).cwiseMax(0.0f);
+            }
+            ws.outputs[r].middleCols(c, bc).noalias() = W[hidden_layers] * ws.activations[hidden_layers-1].leftCols(bc);
+        }
+    }
+
+    for(size_t r = 0; r < count; r++) {
+        robots[r]->applyOutput(ws.outputs[r]);
+    }
+}
+
+void NNRobot::applyOutput(const Eigen::MatrixXf& x) {
+    masses = randMasses;
+
+    // positions scaled so the farthest mass lies at radius 10
+    float maxNorm = 0.0f;
+    for (int i = 0; i < x.cols(); ++i) {
+        float norm = x.col(i).head(output_size - MATERIAL_COUNT).norm();
+        if(maxNorm < norm) maxNorm = norm;
+    }
+
+    for(uint i = 0; i < masses.size(); i++) {
+        masses[i].pos = masses[i].protoPos = 10 * x.col(i).head(output_size - MATERIAL_COUNT) / maxNorm;
+
+        // softmax is monotonic, so the most probable material is the largest logit
+        int maxIdx;
+        x.col(i).tail(MATERIAL_COUNT).maxCoeff(&maxIdx);
+        masses[i].material = materials::matLookup(maxIdx);
+    }
+}
+
+// Counts non-air masses per cell of a coarse grid (about eight masses per
+// cell when the box is evenly filled) and returns the share of them in the
+// largest 26-connected group of occupied cells
+float LargestComponentFraction(const std::vector<Mass>& masses, const Eigen::Vector3f& lo,
+                               const Eigen::Vector3f& extent, uint count) {
+    float cell = 2.0f * std::cbrt(extent.x() * extent.y() * extent.z() / count);
+    int nx = std::min<int>((int) (extent.x() / cell) + 1, 64),
+        ny = std::min<int>((int) (extent.y() / cell) + 1, 64),
+        nz = std::min<int>((int) (extent.z() / cell) + 1, 64);
+    std::vector<uint> occupancy(nx*ny*nz, 0);
+    for(const Mass& m : masses) {
+        if(m.material == materials::air) continue;
+        Eigen::Vector3f u = (m.pos - lo) / cell;
+        int i = std::min<int>(u.x(), nx-1), j = std::min<int>(u.y(), ny-1), k = std::min<int>(u.z(), nz-1);
+        occupancy[(k*ny + j)*nx + i]++;
     }
+
+    uint largest = 0;
+    std::vector<int> stack;
+    for(int c = 0; c < nx*ny*nz; c++) {
+        if(occupancy[c] == 0) continue;
+        uint size = 0;
+        stack.push_back(c);
+        size += occupancy[c];
+        occupancy[c] = 0;
+        while(!stack.empty()) {
+            int s = stack.back();
+            stack.pop_back();
+            int i = s % nx, j = (s / nx) % ny, k = s / (nx*ny);
+            for(int dk = -1; dk <= 1; dk++)
+            for(int dj = -1; dj <= 1; dj++)
+            for(int di = -1; di <= 1; di++) {
+                int a = i+di, b = j+dj, d = k+dk;
+                if(a < 0 || b < 0 || d < 0 || a >= nx || b >= ny || d >= nz) continue;
+                int n = (d*ny + b)*nx + a;
+                if(occupancy[n] == 0) continue;
+                size += occupancy[n];
+                occupancy[n] = 0;
+                stack.push_back(n);
+            }
+        }
+        largest = std::max(largest, size);
+    }
+    return (float) largest / count;
+}
+
+bool NNRobot::Screen() {
+    mValid = true;
+    if(!screen_options.enabled) return true;
+    PERF_SCOPE("nn.screen", 0);
+
+    Eigen::Vector3f lo, hi;
+    uint count = 0;
+    bool muscle = false;
+    for(const Mass& m : masses) {
+        if(m.material == materials::air) continue;
+        if(count == 0) lo = hi = m.pos;
+        lo = lo.cwiseMin(m.pos);
+        hi = hi.cwiseMax(m.pos);
+        count++;
+        muscle |= m.material.dL0 != 0.0f;
+    }
+
+    Eigen::Vector3f extent = hi - lo;
+    if(count < std::max(screen_options.min_masses, 4u) ||
+       extent.minCoeff() < screen_options.min_extent ||
+       (screen_options.require_muscle && !muscle) ||
+       LargestComponentFraction(masses, lo, extent.cwiseMax(1e-3f), count) < screen_options.min_connected) {
+        mValid = false;
+        springs.clear();
+        faces.clear();
+        cells.clear();
+        boundaryCount = 0;
+    }
+    return mValid;
+}
+
+Triangulation::MeshOptions NNRobot::meshOptions() {
+    Triangulation::MeshOptions options;
+    options.type = mesh_type;
+    options.alpha_mode = alpha_mode;
+    options.alpha = alpha;
+    options.cached_alpha = &cached_alpha;
+    options.lattice_spacing = lattice_spacing;
+    return options;
 }
 
-void NNRobot::BatchBuild(std::vector<NNRobot>& robots) {
-    const auto processor_count = std::thread::hardware_concurrency() - 1;
+void NNRobot::BatchBuild(std::vector<NNRobot>& robots, unsigned int num_threads) {
+    if(robots.size() == 0) return;
+    TRACE_SCOPE("BatchBuild", "build");
+    unsigned int processor_count = num_threads;
+    if(processor_count == 0) processor_count = std::thread::hardware_concurrency() - 1;
+    if(processor_count < 1) processor_count = 1;
     unsigned int active_threads = min(robots.size(), processor_count);
     unsigned int robots_per_thread = (robots.size() + active_threads - 1) / active_threads;
     
     fillRandMasses(maxMasses);
-    std::vector<std::thread> threads;
-    uint begin, end;
-    for(unsigned int i = 0; i < active_threads; i++) {
-        begin = i*robots_per_thread;
-        end = min((i+1)*robots_per_thread, robots.size());
-        threads.emplace_back(BuildSubset, std::ref(robots), begin, end);
-    }
 
-    for (auto& thread : threads) {
-        thread.join();
+    // forward passes in contiguous slices so each worker batches its robots
+    util::ParallelFor(robots.size(), active_threads, [&](size_t begin, size_t end) {
+        TRACE_SCOPE("Forward", "build");
+        static thread_local NNRobot::ForwardWorkspace ws;
+        NNRobot::BatchForward(robots, begin, end, ws);
+        for(size_t i = begin; i < end; i++) robots[i].Screen();
+    }, robots_per_thread);
+
+    // only robots that passed the screen are meshed
+    std::vector<size_t> valid;
+    std::vector<const std::vector<Mass>*> mass_groups;
+    for(size_t i = 0; i < robots.size(); i++) {
+        if(!robots[i].isValid()) continue;
+        valid.push_back(i);
+        mass_groups.push_back(&robots[i].masses);
     }
+    std::vector<Triangulation::Mesh> meshes = Triangulation::Batch(mass_groups, meshOptions(), active_threads);
+
+    util::ParallelFor(valid.size(), active_threads, [&](size_t begin, size_t end) {
+        for(size_t i = begin; i < end; i++) {
+            TRACE_SCOPE("Build", "build");
+            robots[valid[i]].BuildFromMesh(std::move(meshes[i]));
+        }
+    }, robots_per_thread);
 }
 
 /*
@@ -250,21 +474,34 @@ void sortBoundaryMasses(std::vector<Mass>& masses, Triangulation::Mesh& mesh) {
 }
 
 void NNRobot::Build() {
-    masses.clear();
+    forward();
+    if(Screen()) BuildFromMasses();
+}
+
+void NNRobot::BuildFromMasses() {
+    BuildFromMesh(Triangulation::Triangulate(masses, meshOptions()));
+}
+
+void NNRobot::BuildFromMesh(Triangulation::Mesh triangulation) {
+    util::perf::Scope build_scope("nn.build");
+
     springs.clear();
     faces.clear();
     cells.clear();
     boundaryCount = 0;
 
-    // auto start = std::chrono::high_resolution_clock::now();
-    forward();
-
-    // auto end = std::chrono::high_resolution_clock::now();
-    // auto execute_time = std::chrono::duration<float>(end - start).count();
-    // printf("INFERENCE IN %f SECONDS\n", execute_time);
-
-    // start = std::chrono::high_resolution_clock::now();
-    auto triangulation = Triangulation::AlphaShape(this->masses);
+    if(mesh_type == MESH_LATTICE) {
+        // masses that lost their lattice site to a closer mass carry no
+        // springs, drop them from the body
+        std::vector<bool> connected(masses.size(), false);
+        for(const auto& e : triangulation.edges) {
+            connected[e.v1] = true;
+            connected[e.v2] = true;
+        }
+        for(Mass& m : masses) {
+            if(!connected[m.id]) m.material = materials::air;
+        }
+    }
 
     // auto triangulation = Triangulation::KNN(this->masses,springs_per_mass);
     
@@ -344,4 +581,5 @@ void NNRobot::Build() {
     ShiftY(*this);
 
     updateBaseline();
+    build_scope.setSprings(springs.size());
 }
\ No newline at end of file
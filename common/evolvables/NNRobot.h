@@ -6,6 +6,7 @@
 #include <string>
 #include <Eigen/Dense>
 #include "SoftBody.h"
+#include "triangulation.h"
 #include "config.h"
 
 #define MIN_FITNESS (float) 0
@@ -16,10 +17,6 @@ private:
         return x.array().max(0);
     }
 
-    Eigen::MatrixXf tanh(const Eigen::MatrixXf& x) {
-        return x.array().tanh();
-    }
-
     Eigen::MatrixXf softmax(const Eigen::MatrixXf& input) {
         Eigen::MatrixXf output(input.rows(), input.cols());
         for (int j = 0; j < input.cols(); j++) {
@@ -31,65 +28,11 @@ private:
         return output;
     }
 
-    Eigen::MatrixXf addBias(const Eigen::MatrixXf& A) {
-        Eigen::MatrixXf B(A.rows()+1, A.cols());
-        B.topRows(A.rows()) = A;
-        B.row(A.rows()).setOnes();
-        return B;
-    }
-
-    void forward() {
-        if(!randMassesFilled) {
-            fillRandMasses(maxMasses);
-        }
-        masses = randMasses;
-        
-        Eigen::MatrixXf input(input_size, masses.size());
-
-        for(size_t i = 0; i < masses.size(); i++) {
-            Mass m = masses[i];
-            input.col(i) << m.protoPos.x(), m.protoPos.y(), m.protoPos.z();
-        }
-
-        Eigen::MatrixXf x = input;
-        for (unsigned int i = 0; i < num_layers-2; i++) {
-            // x = addBias(x);
-            x = weights[i] * x;
-            x = relu(x);
-        }
-
-        // x = addBias(x);
-        x = weights[num_layers-2] * x;
-
-        // tanh activation to position rows
-        // x.topRows(output_size - MATERIAL_COUNT) = tanh(x.topRows(output_size - MATERIAL_COUNT)); 
-        float maxNorm = 0.0f;
-        for (int i = 0; i < x.cols(); ++i) {
-            float norm = x.col(i).head(output_size - MATERIAL_COUNT).norm();
-            if(maxNorm < norm) maxNorm = norm;
-        }
-        x.topRows(output_size - MATERIAL_COUNT) = 10 * x.topRows(output_size - MATERIAL_COUNT) / maxNorm;
-
-        
-        // softmax activation to material rows
-        x.bottomRows(MATERIAL_COUNT) = softmax(x.bottomRows(MATERIAL_COUNT)); 
-
-        Eigen::MatrixXf output = x;
-        Eigen::MatrixXf positions = output.topRows(3);
-        Eigen::MatrixXf material_probs = output.bottomRows(MATERIAL_COUNT);
-        
-        for(uint i = 0; i < masses.size(); i++) {
-            // Eigen::Vector3f = psoitions.col(i);
-            masses[i].pos = masses[i].protoPos = positions.col(i);
+    // Single robot forward pass through a thread local workspace
+    void forward();
 
-            // printf("{%f,%f,%f}\n",masses[i].pos());
-
-            Eigen::VectorXf mat_prob = material_probs.col(i);
-            int maxIdx;
-            mat_prob.maxCoeff(&maxIdx);
-            masses[i].material = materials::matLookup(maxIdx);
-        }
-    }
+    // Positions and materials from a raw (output_size x masses) network output
+    void applyOutput(const Eigen::MatrixXf& output);
 
 protected:
     std::vector<Eigen::MatrixXf> weights;
@@ -101,9 +44,16 @@ protected:
     static int springs_per_mass;
     static CrossoverDistribution crossover_distribution;
     static CrossoverType crossover_type;
+    static AlphaMode alpha_mode;
+    static float alpha;
+    static std::atomic<float> cached_alpha; // found by the first ALPHA_CACHED build, negative until then
+    static MeshType mesh_type;
+    static float lattice_spacing;
+    static Config::NNRobot::Screen screen_options;
 
     static bool randMassesFilled;
     static std::vector<Mass> randMasses;
+    static Eigen::MatrixXf randInput;  // 3 x N protoPos of randMasses
     
     constexpr static unsigned int input_size = 3;
     constexpr static unsigned int output_size = 3 + MATERIAL_COUNT;
@@ -130,6 +80,11 @@ public:
                 Mass m(i,x,y,z);
                 randMasses.push_back(m);
             }
+
+            randInput.resize(input_size, N);
+            for(unsigned int i = 0; i < N; i++) {
+                randInput.col(i) = randMasses[i].protoPos;
+            }
         }
         randMassesFilled = true;
     }
@@ -145,22 +100,62 @@ public:
         NNRobot::crossover_distribution = config.crossover_distribution;
         NNRobot::crossover_type = config.crossover_type;
 
+        NNRobot::alpha_mode = config.alpha_mode;
+        NNRobot::alpha = config.alpha;
+        ResetBuildCache();
+        NNRobot::mesh_type = config.mesh_type;
+        NNRobot::lattice_spacing = config.lattice_spacing;
+        NNRobot::screen_options = config.screen;
+
         NNRobot::maxMasses = config.massCount;
         NNRobot::maxSprings = config.massCount * config.springs_per_mass;
 
+        // regenerate the shared input cloud when the mass count changes
+        if(randMasses.size() != config.massCount) randMassesFilled = false;
         fillRandMasses(config.massCount);
         randMassesFilled = true;
     }
     
+    // Forgets the cached alpha, so the next ALPHA_CACHED build searches
+    // again. Configure and every new optimizer run call this.
+    static void ResetBuildCache() { cached_alpha = -1.0f; }
+    static float CachedAlpha() { return cached_alpha; }
+
     // NNRobot class configuration functions
     static void SetArchitecture(const std::vector<unsigned int>& hidden_layer_sizes = std::vector<unsigned int>{25,25}) {
         NNRobot::num_layers = hidden_sizes.size()+2;
         NNRobot::hidden_sizes = hidden_layer_sizes;
     }
 
+    // Reusable buffers for BatchForward. Columns of the shared input cloud
+    // are processed in blocks so the hidden activations stay in cache.
+    constexpr static unsigned int forward_block_size = 256;
+    struct ForwardWorkspace {
+        std::vector<Eigen::MatrixXf> activations; // hidden_size x block, per hidden layer
+        std::vector<Eigen::MatrixXf> outputs;     // output_size x masses, per robot
+    };
+
+    // Runs the forward pass of robots [begin, end) against the shared
+    // input cloud, filling their masses
+    static void BatchForward(std::vector<NNRobot>& robots, size_t begin, size_t end, ForwardWorkspace& ws);
+    static void forwardBlocked(NNRobot* const* robots, size_t count, ForwardWorkspace& ws);
+    // Unblocked forward pass of one robot over its whole input cloud, with
+    // a full softmax over the material rows: the path BatchForward
+    // replaced, kept as the reference it is tested against
+    void ReferenceForward();
+
     // Initializers
     void Build();
-	static void BatchBuild(std::vector<NNRobot>& robots);
+    // Springs, faces and cells from the masses set by the forward pass
+    void BuildFromMasses();
+    void BuildFromMesh(Triangulation::Mesh mesh);
+    // Cheap checks on the masses from the forward pass. A robot that fails
+    // is marked invalid and left without springs, so meshing and
+    // simulation skip it. Returns whether the robot passed.
+    bool Screen();
+    static Triangulation::MeshOptions meshOptions();
+	// num_threads = 0 uses all but one hardware thread
+	static void BatchBuild(std::vector<NNRobot>& robots, unsigned int num_threads = 0);
 
     NNRobot();
 
@@ -171,6 +166,20 @@ public:
     NNRobot(const NNRobot& src) : SoftBody(src),
         weights(src.weights)
     { }
+
+    NNRobot(NNRobot&& src) noexcept : SoftBody(std::move(src)),
+        weights(std::move(src.weights))
+    { }
+
+    NNRobot(const NNRobot& src, GenomeOnly g) : SoftBody(src, g),
+        weights(src.weights)
+    { }
+
+    // Copy of the weights and candidate state without the built body,
+    // for children that are rebuilt anyway
+    NNRobot CloneGenome() const { return NNRobot(*this, GenomeOnly()); }
+
+    const std::vector<Eigen::MatrixXf>& getWeights() const { return weights; }
     
     void Randomize() override;
     void Mutate() override;
@@ -179,6 +188,9 @@ public:
 
     static float Distance(const CandidatePair<NNRobot>& robots);
 
+    // Content hash of the weights, equal genomes build equal robots
+    uint64_t GenomeHash() const;
+
     friend void swap(NNRobot& r1, NNRobot& r2) {
         using std::swap;
         swap(r1.weights, r2.weights);
@@ -193,7 +205,7 @@ public:
         return *this;
     }
     
-    static std::vector<float> findDiversity(std::vector<NNRobot> pop);
+    static std::vector<float> findDiversity(const std::vector<NNRobot>& pop);
 };
 
 #endif
\ No newline at end of file
@@ -15,8 +15,9 @@
 #define max(a,b) a > b ? a : b
 
 unsigned SoftBody::seed = std::chrono::system_clock::now().time_since_epoch().count();
-std::default_random_engine SoftBody::gen = std::default_random_engine(SoftBody::seed);
-std::uniform_real_distribution<> SoftBody::uniform = std::uniform_real_distribution<>(0.0,1.0);
+thread_local std::default_random_engine SoftBody::gen = std::default_random_engine(
+    SoftBody::seed ^ (unsigned) std::hash<std::thread::id>()(std::this_thread::get_id()));
+thread_local std::uniform_real_distribution<> SoftBody::uniform = std::uniform_real_distribution<>(0.0,1.0);
 
 Eigen::Matrix3f rotation_matrix(double degrees, const Eigen::Vector3f& axis)
 {
@@ -123,6 +124,7 @@ void SoftBody::updateCOM() {
 
 void SoftBody::updateFitness() {
     updateCOM();
+    mEstimated = false;
 
     if(!mValid) {
         mFitness = 0.0f;
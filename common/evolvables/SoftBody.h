@@ -23,8 +23,9 @@ struct RadiiSoftBodyEncoding {
 class SoftBody : public Element, public Candidate {
 protected:
 	static unsigned seed;
-    static std::default_random_engine gen;
-    static std::uniform_real_distribution<> uniform;
+    // one generator per thread, so islands can mutate and cross in parallel
+    static thread_local std::default_random_engine gen;
+    static thread_local std::uniform_real_distribution<> uniform;
 
 	float   mVolume = 0.0f;
     float   mLength = 1.0f;
@@ -41,7 +42,55 @@ public:
 	mVolume(src.mVolume), mLength(src.mLength), mBaseCOM(src.mBaseCOM)
 	{}
 
+	SoftBody(SoftBody&& src) noexcept :
+	Element{std::move(src.masses), std::move(src.springs), std::move(src.faces), std::move(src.cells), src.boundaryCount}, Candidate(src),
+	mVolume(src.mVolume), mLength(src.mLength), mBaseCOM(src.mBaseCOM)
+	{}
+
+	// Tag for copying a robot without its built body (see CloneGenome)
+	struct GenomeOnly {};
+
+	SoftBody(const SoftBody& src, GenomeOnly) : Candidate(src) { mParentFlag = false; }
+
 	static void BatchBuild(std::vector<SoftBody>);
+	// Drops anything builds have learned from earlier robots (see NNRobot)
+	static void ResetBuildCache() {}
+
+	// Everything Build produces from a genome, so a cached build can be
+	// restored without rebuilding
+	struct Phenotype {
+		Element body;
+		float volume = 0.0f;
+		bool valid = true;
+	};
+
+	Phenotype getPhenotype() const {
+		return {Element{masses, springs, faces, cells, boundaryCount}, mVolume, mValid};
+	}
+
+	bool hasPhenotype() const { return !masses.empty(); }
+
+	// Frees the built body. Fitness, validity and volume are kept, so a
+	// released robot still sorts and selects; Build or setPhenotype
+	// brings the body back when it has to be written or simulated again.
+	void ReleasePhenotype() {
+		std::vector<Mass>().swap(masses);
+		std::vector<Spring>().swap(springs);
+		std::vector<Face>().swap(faces);
+		std::vector<Cell>().swap(cells);
+		boundaryCount = 0;
+	}
+
+	void setPhenotype(const Phenotype& p) {
+		masses = p.body.masses;
+		springs = p.body.springs;
+		faces = p.body.faces;
+		cells = p.body.cells;
+		boundaryCount = p.body.boundaryCount;
+		mVolume = p.volume;
+		mValid = p.valid;
+		updateBaseline();
+	}
 
     std::string Encode() const;
 	void Decode(const std::string& filename);
@@ -64,6 +113,8 @@ public:
 	float getSimTime() const { return sim_time; }
 	float getTotalSimTime() const { return total_sim_time; }
 	Eigen::Vector3f getCOM() const { return mCOM; }
+	Eigen::Vector3f getBaseCOM() const { return mBaseCOM; }
+	float getLength() const { return mLength; }
 	Eigen::Vector3f getClosestPos() const { return mClosestPos; }
     void incrementSimTime(float dt) { sim_time += dt; total_sim_time += dt; }
     void resetSimTime() { sim_time = 0; }
@@ -111,11 +162,8 @@ public:
 		}
 	}
 
-	void setSprings(std::vector<Spring> _springs) {
-		springs.clear();
-		for(Spring& s : _springs) {
-			springs.push_back(s);
-		}
+	void setSprings(const std::vector<Spring>& _springs) {
+		springs.assign(_springs.begin(), _springs.end());
 	}
 
 	void updateCOM();
@@ -3,7 +3,10 @@
 #include <fstream>
 #include <sstream>
 #include <thread>
+#include <algorithm>
 #include "VoxelRobot.h"
+#include "parallel.h"
+#include "hash.h"
 
 VoxelRobot::Encoding VoxelRobot::repr = VoxelRobot::ENCODE_RADIUS;
 
@@ -16,8 +19,9 @@ void Voxel::setRandomMaterial() {
 
 void Circle::Randomize(float xlim, float ylim, float zlim) {
     static unsigned seed = std::chrono::system_clock::now().time_since_epoch().count();
-    static std::default_random_engine gen = std::default_random_engine(seed);
-    static std::uniform_real_distribution<> uniform = std::uniform_real_distribution<>(0.0,1.0);
+    static thread_local std::default_random_engine gen = std::default_random_engine(
+        seed ^ (unsigned) std::hash<std::thread::id>()(std::this_thread::get_id()));
+    static thread_local std::uniform_real_distribution<> uniform = std::uniform_real_distribution<>(0.0,1.0);
     
     Eigen::Vector3f new_center;
     new_center.x() = xlim*uniform(gen);
@@ -55,256 +59,201 @@ void ShiftX(VoxelRobot& R) {
     R.translate(translation);
 }
 
-// Note mMasses.size == voxels.size
-// Builds spring from srcIdx to vIdx
-void VoxelRobot::BuildSpringsRecurse(std::vector<Spring>& _springs, BasisIdx indices, std::vector<bool>& visit_list, uint srcIdx) {
-    if(!isValidIdx(indices)) return;
-
-    uint vIdx = getVoxelIdx(indices);
-
-    Voxel v = voxels[vIdx];
-    Voxel v_src = voxels[srcIdx];
-
-    if(srcIdx != vIdx) {
-        // Spring mean length
-        float L = (v_src.base - v.base).norm();
-        
-        //  Get material of all owning voxels
-        BasisIdx path = indices - v_src.indices;
-        Material mat, avgMat;
-        uint32_t matEncoding = 0x00u;
-
-        BasisIdx neighbors[4];
-        for(uint i = 0; i < 4; i++) {
-            neighbors[i] = {0,0,0};
-        }
-        if(abs(path.x)+abs(path.y)+abs(path.z) == 1) { // cardinal
-            if(abs(path.x) == 1) {
+namespace {
+
+// How a spring takes its material from the voxels owning its edge
+enum OwnerRule {
+    OWNERS_UNION,       // union of the non-air owners inside the grid
+    OWNERS_UNION_PAIR,  // union of both owners, the first alone when the second is outside the grid
+    OWNER_FIRST         // material of the first owner
+};
+
+struct SpringStencil {
+    BasisIdx offset;    // spring end relative to the source voxel
+    OwnerRule rule;
+    uint ownerCount;
+    BasisIdx owners[4]; // owning voxels relative to the source voxel
+};
+
+// The 13 offsets that reach every lattice neighbour exactly once:
+// 001..111, the face diagonals 1-10, 01-1, -101 and the body diagonals
+// -111, 1-11, 11-1. Edges along an axis are owned by the (up to) four
+// voxels around them, face diagonals by the voxel whose face they cross
+// and its neighbour across that face, body diagonals by the voxel they
+// cross. Owners of offsets reaching back along an axis start one voxel
+// back along it.
+std::vector<SpringStencil> MakeSpringStencil() {
+    std::vector<BasisIdx> offsets;
+    for(int k = 1; k < 8; k++) offsets.push_back({k%2, (k/2)%2, (k/4)%2});
+    offsets.insert(offsets.end(), {{1,-1,0}, {0,1,-1}, {-1,0,1}});
+    offsets.insert(offsets.end(), {{-1,1,1}, {1,-1,1}, {1,1,-1}});
+
+    std::vector<SpringStencil> stencil;
+    for(const BasisIdx& o : offsets) {
+        SpringStencil s = {o, OWNERS_UNION, 0, {}};
+        BasisIdx back = {-(o.x == -1), -(o.y == -1), -(o.z == -1)};
+        switch(abs(o.x) + abs(o.y) + abs(o.z)) {
+            case 1:
                 for(int i = 0; i < 4; i++) {
-                    BasisIdx nprox = {0,(i/2)%2,i%2}; 
-                    neighbors[i] = v_src.indices - nprox;
-                }
-            } else if (abs(path.y) == 1) {
-                for(int i = 0; i < 4; i++) {
-                    BasisIdx nprox = {(i/2)%2,0,i%2}; 
-                    neighbors[i] = v_src.indices - nprox;
-                }
-            } else if (abs(path.z) == 1) {
-                for(int i = 0; i < 4; i++) {
-                    BasisIdx nprox = {(i/2)%2,i%2,0};
-                    neighbors[i] = v_src.indices - nprox;
-                }
-            }
-            for(uint i = 0; i < 4; i++) {
-                if(!isValidIdx(neighbors[i])) continue;
-                Voxel neighbor = voxels[getVoxelIdx(neighbors[i])];
-                if(neighbor.mat.encoding != materials::air.encoding)
-                    matEncoding |= neighbor.mat.encoding;
-            }
-            mat = materials::decode(matEncoding);
-        } else if(abs(path.x)+abs(path.y)+abs(path.z) == 2) { // diagonal
-            BasisIdx nprox = {!path.x,!path.y,!path.z};
-            BasisIdx neighborIdx = v_src.indices - nprox;
-            if(path.x >= 0 && path.y >= 0 && path.z >= 0 ){
-                if(!isValidIdx(neighborIdx)) {
-                    mat = v_src.mat;
-                } else {
-                    Voxel neighbor = voxels[getVoxelIdx(neighborIdx)];
-                    if(neighbor.mat.encoding != materials::air.encoding)
-                        matEncoding |= neighbor.mat.encoding;
-                    if(v_src.mat.encoding != materials::air.encoding)
-                        matEncoding |= v_src.mat.encoding;
-
-                    mat = materials::decode(matEncoding);
+                    int a = (i/2)%2, b = i%2;
+                    if(o.x)      s.owners[i] = {0, -a, -b};
+                    else if(o.y) s.owners[i] = {-a, 0, -b};
+                    else         s.owners[i] = {-a, -b, 0};
                 }
-            } else {
-                BasisIdx srcprx = {path.x==-1,path.y==-1,path.z==-1};
-                BasisIdx matSrcIdx = v_src.indices - srcprx;
-                Voxel v_matsrc = voxels[getVoxelIdx(matSrcIdx)];
-                BasisIdx neighborIdx = matSrcIdx - nprox;
-
-                if(!isValidIdx(neighborIdx)) {
-                    mat = v_matsrc.mat;
-                } else {
-                    Voxel neighbor = voxels[getVoxelIdx(neighborIdx)];
-                    if(neighbor.mat.encoding != materials::air.encoding)
-                        matEncoding |= neighbor.mat.encoding;
-                    if(v_matsrc.mat.encoding != materials::air.encoding)
-                        matEncoding |= v_matsrc.mat.encoding;
-                    
-                    mat = materials::decode(matEncoding);
-                }
-            }
-        } else { // body diagonal
-            if(path.x >= 0 && path.y >= 0 && path.z >= 0 ){
-                mat = v_src.mat;
-            } else { // backtrack body diagonals
-                BasisIdx srcprx = {path.x==-1,path.y==-1,path.z==-1};
-                BasisIdx matSrcIdx = v_src.indices - srcprx;
-                Voxel v_matsrc = voxels[getVoxelIdx(matSrcIdx)];
-                mat = v_matsrc.mat;
-            }
+                s.ownerCount = 4;
+                break;
+            case 2:
+                s.rule = OWNERS_UNION_PAIR;
+                s.owners[0] = back;
+                s.owners[1] = {back.x - !o.x, back.y - !o.y, back.z - !o.z};
+                s.ownerCount = 2;
+                break;
+            default:
+                s.rule = OWNER_FIRST;
+                s.owners[0] = back;
+                s.ownerCount = 1;
         }
-
-        Spring s{(uint16_t) srcIdx,(uint16_t) vIdx,L,L,mat};
-        _springs.push_back(s);
-    }
-
-
-    if(visit_list[vIdx]) return;
-    visit_list[vIdx] = true;
-    //  Adds the following to the basis indices:
-    //  001, 010, 011, 100, 101, 110, 111
-    int x,y,z;
-    uint tempx,tempy;
-    for(uint k = 1; k < 8; k++) {
-        x = k%2;
-        y = (k/2)%2;
-        z = (k/4)%2;
-        BasisIdx offset = {x,y,z};
-        BuildSpringsRecurse(_springs, indices + offset, visit_list, vIdx);
-    }
-
-    //  Adds the following to the basis indices:
-    // 1-10, 01-1,-101
-    x = 1; y = -1; z = 0;
-    for(uint k = 0; k < 3; k++) {
-        BasisIdx offset = {x,y,z};
-        BuildSpringsRecurse(_springs, indices + offset, visit_list, vIdx);
-        tempx = x;
-        tempy = y;
-        x = z;
-        y = tempx;
-        z = tempy;
-    }
-
-    //  Adds the following to the basis indices:
-    // -111,1-11,11-1
-    x = -1; y = 1; z = 1;
-    for(uint k = 0; k < 3; k++) {
-        BasisIdx offset = {x,y,z};
-        BuildSpringsRecurse(_springs, indices + offset, visit_list, vIdx);
-        tempx = x;
-        tempy = y;
-        x = z;
-        y = tempx;
-        z = tempy;
+        stencil.push_back(s);
     }
+    return stencil;
 }
 
-// Gets number of non-air adjacent voxels
-uint VoxelRobot::ConnectedVoxelRecurse(BasisIdx ind, std::vector<bool>& visit_list) {
-    uint numConnected = 0;
-    uint idx = getVoxelIdx(ind);
-
-    if(!isValidIdx(ind)) return 0;
-    if(visit_list[idx] == true) return 0;
+const std::vector<SpringStencil> spring_stencil = MakeSpringStencil();
 
-    visit_list[idx] = true;
-    Voxel v = voxels[idx];
-    
-    if(v.mat == materials::air) {
-        return 0;
-    }
-
-    numConnected = 1;
-
-    // 100, 010, 001
-    int x = 1, y = 0, z = 0;
-    // voxel postive and negative cardinal directions
-    Voxel v_pos, v_neg;
-    int tempx, tempy;
-    for(uint k = 0; k < 3; k++) {
-        BasisIdx pos_offset = {x,y,z};
-        numConnected += ConnectedVoxelRecurse(ind + pos_offset, visit_list);
-
-        BasisIdx neg_offset = {-x,-y,-z};
-        numConnected += ConnectedVoxelRecurse(ind + neg_offset, visit_list);
-
-        tempx = x;
-        tempy = y;
-        x = z;
-        y = tempx;
-        z = tempy;
-    }
-
-    return numConnected;
 }
 
-void VoxelRobot::CopyFromVoxelRecurse(BasisIdx ind, VoxelRobot& R, std::vector<bool>& visit_list) {
-    if(!isValidIdx(ind)) return;
-    uint idx = getVoxelIdx(ind);
-
-    if(visit_list[idx] == true) return;
-
-    visit_list[idx] = true;
-
-    Voxel v = voxels[idx];
-
-    if(v.mat == materials::air) return;
-
-    R.voxels[idx] = voxels[idx];
-
-    // voxel postive and negative cardinal directions
-    Voxel v_pos, v_neg;
-    int x = 1, y = 0, z = 0;
-    int tempx, tempy;
-    for(uint k = 0; k < 3; k++) {
-        BasisIdx pos_offset = {x,y,z};
-        CopyFromVoxelRecurse(ind + pos_offset, R, visit_list);
-
-        BasisIdx neg_offset = {-x,-y,-z};
-        CopyFromVoxelRecurse(ind + neg_offset, R, visit_list);
-
-        tempx = x;
-        tempy = y;
-        x = z;
-        y = tempx;
-        z = tempy;
+// Note mMasses.size == voxels.size
+// One sweep over the grid, each voxel connects to its in-grid stencil
+// neighbours (air voxels included, as they keep their masses)
+void VoxelRobot::BuildSprings(std::vector<Spring>& _springs) {
+    _springs.reserve(_springs.size() + spring_stencil.size() * voxels.size());
+
+    auto nonAir = [](const Material& mat) {
+        return mat.encoding != materials::air.encoding ? mat.encoding : 0x00u;
+    };
+
+    for(int z = 0; z < (int) zCount; z++) {
+        for(int y = 0; y < (int) yCount; y++) {
+            for(int x = 0; x < (int) xCount; x++) {
+                uint srcIdx = getVoxelIdx(x, y, z);
+                const Eigen::Vector3f& srcBase = voxels[srcIdx].base;
+
+                for(const SpringStencil& s : spring_stencil) {
+                    BasisIdx dst = {x + s.offset.x, y + s.offset.y, z + s.offset.z};
+                    if(!isValidIdx(dst)) continue;
+                    uint vIdx = getVoxelIdx(dst);
+
+                    BasisIdx owners[4];
+                    bool valid[4];
+                    for(uint i = 0; i < s.ownerCount; i++) {
+                        owners[i] = {x + s.owners[i].x, y + s.owners[i].y, z + s.owners[i].z};
+                        valid[i] = isValidIdx(owners[i]);
+                    }
+
+                    Material mat;
+                    uint32_t matEncoding = 0x00u;
+                    switch(s.rule) {
+                        case OWNERS_UNION:
+                            for(uint i = 0; i < s.ownerCount; i++) {
+                                if(valid[i]) matEncoding |= nonAir(voxels[getVoxelIdx(owners[i])].mat);
+                            }
+                            mat = materials::decode(matEncoding);
+                            break;
+                        case OWNERS_UNION_PAIR:
+                        {
+                            const Material& first = voxels[getVoxelIdx(owners[0])].mat;
+                            if(!valid[1]) {
+                                mat = first;
+                            } else {
+                                matEncoding = nonAir(first) | nonAir(voxels[getVoxelIdx(owners[1])].mat);
+                                mat = materials::decode(matEncoding);
+                            }
+                        }
+                        break;
+                        case OWNER_FIRST:
+                            mat = voxels[getVoxelIdx(owners[0])].mat;
+                            break;
+                    }
+
+                    float L = (srcBase - voxels[vIdx].base).norm();
+                    _springs.push_back({(uint16_t) srcIdx, (uint16_t) vIdx, L, L, mat});
+                }
+            }
+        }
     }
 }
 
+// Keeps the largest 6-connected body of non-air voxels and turns every
+// other voxel to air; ties go to the body with the lowest voxel index.
+// Union-find labels all bodies in one sweep: each voxel is joined with its
+// -x, -y and -z neighbours, which the sweep has already visited.
 void VoxelRobot::Strip() {
-    std::vector<bool> visited(voxels.size(), false);
-    std::vector<uint> connected_count(voxels.size());
-    uint idx = 0;
-    uint maxIdx = 0;
-    for(Voxel& v : voxels) {
-        connected_count[idx] = ConnectedVoxelRecurse(v.indices, visited);
-        if(connected_count[idx] > connected_count[maxIdx]) maxIdx = idx;
-        idx++;
+    static thread_local std::vector<uint> parent;
+    static thread_local std::vector<uint> bodySize;
+    parent.resize(voxels.size());
+    bodySize.resize(voxels.size());
+
+    auto find = [&](uint i) {
+        while(parent[i] != i) {
+            parent[i] = parent[parent[i]];
+            i = parent[i];
+        }
+        return i;
+    };
+    auto join = [&](uint a, uint b) {
+        a = find(a);
+        b = find(b);
+        if(a == b) return;
+        if(bodySize[a] < bodySize[b]) std::swap(a, b);
+        parent[b] = a;
+        bodySize[a] += bodySize[b];
+    };
+    auto solid = [&](uint i) { return !(voxels[i].mat == materials::air); };
+
+    uint layer = xCount*yCount;
+    for(uint z = 0; z < zCount; z++) {
+        for(uint y = 0; y < yCount; y++) {
+            for(uint x = 0; x < xCount; x++) {
+                uint i = getVoxelIdx(x, y, z);
+                parent[i] = i;
+                bodySize[i] = 1;
+                if(!solid(i)) continue;
+                if(x > 0 && solid(i-1))      join(i, i-1);
+                if(y > 0 && solid(i-xCount)) join(i, i-xCount);
+                if(z > 0 && solid(i-layer))  join(i, i-layer);
+            }
+        }
     }
-    VoxelRobot R = *this;
-    for(Voxel& v: R.voxels) v.mat = materials::air;
-    
-    visited = std::vector<bool>(voxels.size(), false);
-    CopyFromVoxelRecurse(getVoxelBasisIdx(maxIdx), R, visited);
-    *this = R;
-}
 
-void RunBatchBuild(std::vector<VoxelRobot>& robots, size_t begin, size_t end) {
-    for(uint i = begin; i < end; i++) {
-        robots[i].Build();
+    // bodies are met in order of their lowest voxel index
+    uint largest = 0, largestRoot = 0;
+    for(uint i = 0; i < voxels.size(); i++) {
+        if(!solid(i)) continue;
+        uint root = find(i);
+        if(bodySize[root] > largest) {
+            largest = bodySize[root];
+            largestRoot = root;
+        }
+    }
+
+    for(uint i = 0; i < voxels.size(); i++) {
+        if(solid(i) && find(i) != largestRoot) voxels[i].mat = materials::air;
     }
 }
 
-void VoxelRobot::BatchBuild(std::vector<VoxelRobot>& robots) {
-    const auto processor_count = std::thread::hardware_concurrency();
+void VoxelRobot::BatchBuild(std::vector<VoxelRobot>& robots, unsigned int num_threads) {
+    if(robots.size() == 0) return;
+    unsigned int processor_count = num_threads;
+    if(processor_count == 0) processor_count = std::thread::hardware_concurrency();
+    if(processor_count < 1) processor_count = 1;
     unsigned int active_threads = min(robots.size(), processor_count);
-    unsigned int robots_per_thread = robots.size() / active_threads;
-    
-    std::vector<std::thread> threads;
-    uint begin, end;
-    for(unsigned int i = 0; i < active_threads; i++) {
-        begin = i*robots_per_thread;
-        end = min((i+1)*robots_per_thread, robots.size());
-        std::thread t(RunBatchBuild, std::ref(robots), begin, end);
-        threads.push_back(std::move(t));
-    }
+    unsigned int robots_per_thread = (robots.size() + active_threads - 1) / active_threads;
 
-    for(uint i = 0; i < active_threads; i++) {
-        threads[i].join();
-    }
+    util::ParallelFor(robots.size(), active_threads, [&](size_t begin, size_t end) {
+        for(size_t i = begin; i < end; i++) {
+            robots[i].Build();
+        }
+    }, robots_per_thread);
 }
 
 void VoxelRobot::Build() {
@@ -313,16 +262,17 @@ void VoxelRobot::Build() {
 
     mVolume = 0;
 
-    std::vector<bool> visited(voxels.size());
+    // per thread scratch, keeps its capacity across the robots of a BatchBuild
+    static thread_local std::vector<Spring> _springs;
+    _springs.clear();
+
     for(uint i = 0; i < voxels.size(); i++) {
         if(voxels[i].mat != materials::air) mVolume++;
         Mass m(i, voxels[i].base, voxels[i].mat);
         addMass(m);
-        visited[i] = false;
     }
     
-    std::vector<Spring> _springs;
-    BuildSpringsRecurse(_springs, {0,0,0}, visited);
+    BuildSprings(_springs);
     setSprings(_springs);
     ShiftX(*this);
     ShiftY(*this);
@@ -330,20 +280,76 @@ void VoxelRobot::Build() {
     updateBaseline();
 }
 
+namespace {
+
+// Index range [first, last] of the sorted centers within radius of c,
+// padded by one so rounding at the edges is left to the exact test
+void AxisRange(const std::vector<float>& centers, float c, float radius, int& first, int& last) {
+    first = std::lower_bound(centers.begin(), centers.end(), c - radius) - centers.begin() - 1;
+    last = std::upper_bound(centers.begin(), centers.end(), c + radius) - centers.begin();
+    first = std::max<int>(first, 0);
+    last = std::min<int>(last, centers.size() - 1);
+}
+
+}
+
+// Rasterizes each circle over the voxels in its bounding box instead of
+// testing every voxel against every circle. Voxel centers form a regular
+// grid, so the squared distance splits into per axis terms and the
+// innermost test runs over a contiguous row.
 void VoxelRobot::BuildFromCircles() {
-    for(Voxel& v : voxels) {
-        if((uint) v.indices.x == xCount-1 || (uint) v.indices.y == yCount-1 || (uint) v.indices.z == zCount-1)
-            continue;
-        std::vector<Material> mats;
-        uint32_t matEncoding = 0x00u;
-        float dist;
-        for(Circle& c : circles) {
-            dist = (v.center-c.center).norm();
-            if(dist < c.radius) {
-                matEncoding |= c.mat.encoding;
+    // the last layer along each axis stays as it is
+    int nx = (int) xCount - 1, ny = (int) yCount - 1, nz = (int) zCount - 1;
+
+    static thread_local std::vector<float> cx, cy, cz;
+    static thread_local std::vector<uint32_t> encodings;
+    cx.resize(std::max<int>(nx, 0));
+    cy.resize(std::max<int>(ny, 0));
+    cz.resize(std::max<int>(nz, 0));
+    for(int x = 0; x < nx; x++) cx[x] = voxels[getVoxelIdx(x, 0, 0)].center.x();
+    for(int y = 0; y < ny; y++) cy[y] = voxels[getVoxelIdx(0, y, 0)].center.y();
+    for(int z = 0; z < nz; z++) cz[z] = voxels[getVoxelIdx(0, 0, z)].center.z();
+    encodings.assign(voxels.size(), 0x00u);
+
+    for(const Circle& c : circles) {
+        if(c.radius <= 0.0f) continue;
+        float r2 = c.radius * c.radius;
+        uint32_t encoding = c.mat.encoding;
+        int x0, x1, y0, y1, z0, z1;
+        AxisRange(cx, c.center.x(), c.radius, x0, x1);
+        AxisRange(cy, c.center.y(), c.radius, y0, y1);
+        AxisRange(cz, c.center.z(), c.radius, z0, z1);
+
+        for(int z = z0; z <= z1; z++) {
+            float dz = cz[z] - c.center.z();
+            for(int y = y0; y <= y1; y++) {
+                float dy = cy[y] - c.center.y();
+                float dyz = dy*dy + dz*dz;
+                if(dyz >= r2) continue;
+
+                uint32_t* row = &encodings[getVoxelIdx(0, y, z)];
+                for(int x = x0; x <= x1; x++) {
+                    float dx = cx[x] - c.center.x();
+                    row[x] |= (dx*dx + dyz < r2) ? encoding : 0x00u;
+                }
+            }
+        }
+    }
+
+    // neighbouring voxels mostly share an encoding, decode once per run
+    uint32_t lastEncoding = 0x00u;
+    Material lastMat = materials::air;
+    for(int z = 0; z < nz; z++) {
+        for(int y = 0; y < ny; y++) {
+            for(int x = 0; x < nx; x++) {
+                uint i = getVoxelIdx(x, y, z);
+                if(encodings[i] != lastEncoding) {
+                    lastEncoding = encodings[i];
+                    lastMat = materials::decode(lastEncoding);
+                }
+                voxels[i].mat = lastMat;
             }
         }
-        v.mat = materials::decode(matEncoding);
     }
 
     Build();
@@ -501,6 +507,20 @@ float VoxelRobot::Distance(const CandidatePair<VoxelRobot>& robots) {
     return dist;
 }
 
+uint64_t VoxelRobot::GenomeHash() const {
+    std::vector<uint32_t> encodings(voxels.size());
+    for(size_t i = 0; i < voxels.size(); i++) {
+        encodings[i] = voxels[i].mat.encoding;
+    }
+    uint64_t hash = util::HashBytes(encodings.data(), encodings.size() * sizeof(uint32_t));
+    for(const Circle& c : circles) {
+        float shape[4] = {c.center.x(), c.center.y(), c.center.z(), c.radius};
+        hash = util::HashBytes(shape, sizeof(shape), hash);
+        hash = util::HashValue(c.mat.encoding, hash);
+    }
+    return hash;
+}
+
 std::string VoxelRobot::Encode() const {
     std::string encoding;
     encoding += "type=VoxelRobot\n";
@@ -514,7 +534,7 @@ std::string VoxelRobot::Encode() const {
     return encoding;
 }
 
-std::vector<float> VoxelRobot::findDiversity(std::vector<VoxelRobot> pop) {
+std::vector<float> VoxelRobot::findDiversity(const std::vector<VoxelRobot>& pop) {
     size_t pop_size = pop.size();
     std::vector<float> diversity(pop_size, 0);
     // size_t v_size = pop[0].getVoxels().size();
@@ -81,18 +81,16 @@ enum Encoding {
 
     static CandidatePair<VoxelRobot> TwoPointChildren(const CandidatePair<VoxelRobot>& parents);
     static CandidatePair<VoxelRobot> RadiusChildren(const CandidatePair<VoxelRobot>& parents);
-    void BuildSpringsRecurse(std::vector<Spring>& springs, BasisIdx indices, std::vector<bool>& visit_list, uint srcIdx = 0);
+    // Appends the springs of the voxel lattice, 13 per voxel at most
+    void BuildSprings(std::vector<Spring>& springs);
     void BuildFromCircles();
     void Build();
-    void BatchBuild(std::vector<VoxelRobot>& robots);
+    // num_threads = 0 uses all hardware threads
+    static void BatchBuild(std::vector<VoxelRobot>& robots, unsigned int num_threads = 0);
     void Initialize();
 
 
-    // Gets number of non-air connected voxels from a given voxel index
-    uint ConnectedVoxelRecurse(BasisIdx ind, std::vector<bool>& visit_list);
-
-    // Builds a robot R from voxels connected to a source voxel at index ind
-    void CopyFromVoxelRecurse(BasisIdx ind, VoxelRobot& R, std::vector<bool>& visit_list);
+    // Keeps only the largest connected body of non-air voxels, O(voxels)
     void Strip();
 
 private:
@@ -167,8 +165,23 @@ public:
         xCount(src.xCount), yCount(src.yCount), zCount(src.zCount)
     { }
 
+    VoxelRobot(VoxelRobot&& src) noexcept : SoftBody(std::move(src)),
+        xSize(src.xSize), ySize(src.ySize), zSize(src.zSize),
+        resolution(src.resolution), voxels(std::move(src.voxels)), circles(std::move(src.circles)),
+        xCount(src.xCount), yCount(src.yCount), zCount(src.zCount)
+    { }
+
+    VoxelRobot(const VoxelRobot& src, GenomeOnly g) : SoftBody(src, g),
+        xSize(src.xSize), ySize(src.ySize), zSize(src.zSize),
+        resolution(src.resolution), voxels(src.voxels), circles(src.circles),
+        xCount(src.xCount), yCount(src.yCount), zCount(src.zCount)
+    { }
+
     VoxelRobot(const SoftBody& src) : SoftBody(src) { }
 
+    // Copy of the voxels and circles without the built body
+    VoxelRobot CloneGenome() const { return VoxelRobot(*this, GenomeOnly()); }
+
     // TODO: line method, don't assume rect.prism.
     bool isInside(Eigen::Vector3f point) {
         return 
@@ -185,6 +198,7 @@ public:
     }
 
     std::vector<Voxel>& getVoxels() { return voxels; }
+    std::vector<Circle>& getCircles() { return circles; }
 
     void Randomize() override;
     void Mutate() override;
@@ -192,6 +206,9 @@ public:
     
     static CandidatePair<VoxelRobot> Crossover(const CandidatePair<VoxelRobot>& parents);
 
+    // Content hash of the voxel materials and circles
+    uint64_t GenomeHash() const;
+
     std::string Encode() const;
 	void Decode(const std::string& filename);
 
@@ -216,7 +233,7 @@ public:
         return *this;
     }
 
-    static std::vector<float> findDiversity(std::vector<VoxelRobot> pop);
+    static std::vector<float> findDiversity(const std::vector<VoxelRobot>& pop);
 };
 
 #endif
@@ -4,10 +4,13 @@
 #include <CGAL/Alpha_shape_vertex_base_3.h>
 #include <CGAL/Delaunay_triangulation_3.h>
 #include <CGAL/Triangulation_vertex_base_with_info_3.h>
+#include <CGAL/spatial_sort.h>
+#include <CGAL/Spatial_sort_traits_adapter_3.h>
+#include <CGAL/property_map.h>
 
 #include <fstream>
-#include <list>
 #include <cassert>
+#include <cmath>
 
 #include "triangulation.h"
 
@@ -30,15 +33,26 @@ typedef Alpha_shape_3::FT                                FT;
 typedef Tds::Cell_handle                                 Cell_handle;
 typedef Tds::Vertex_handle                               Vertex_handle;
 
-Triangulation::Mesh Triangulation::AlphaShape(const std::vector<Mass>& masses) {
-    std::list<std::pair<Point, uint16_t>> lp;
-    Point p;
+// Per thread buffers reused across alpha shapes, so batched builds keep
+// their capacity from one robot to the next
+struct AlphaScratch {
+    std::vector<std::pair<Point, uint16_t>> points;
+    std::vector<Edge>        edges;
+    std::vector<Facet>       facets;
+    std::vector<Cell_handle> cells;
+};
+
+static thread_local AlphaScratch scratch;
+
+Triangulation::Mesh Triangulation::AlphaShape(const std::vector<Mass>& masses, AlphaMode mode, float alpha,
+                                              std::atomic<float>* cached_alpha) {
+    std::vector<std::pair<Point, uint16_t>>& lp = scratch.points;
+    lp.clear();
 
     for(const auto& m : masses)
     {
         if(m.material == materials::air) continue;
-        p = Point(m.pos.x(), m.pos.y(), m.pos.z());
-        lp.push_back({p,m.id});
+        lp.push_back({Point(m.pos.x(), m.pos.y(), m.pos.z()), m.id});
     }
 
     std::vector<Simplex::Edge> edges;
@@ -49,26 +63,50 @@ Triangulation::Mesh Triangulation::AlphaShape(const std::vector<Mass>& masses) {
         return {edges, facets, cells, isBoundaryVertexFlags};
     }
 
-    for (const auto& point : lp) {
-        assert(point.first.dimension() == 3);
+    // Hilbert sort so consecutive insertions are close to each other and
+    // each point location starts from the previous vertex
+    typedef CGAL::Spatial_sort_traits_adapter_3<K,
+        CGAL::First_of_pair_property_map<std::pair<Point, uint16_t>>> Sort_traits;
+    CGAL::spatial_sort(lp.begin(), lp.end(), Sort_traits());
+
+    Delaunay_3 dt;
+    Delaunay_3::Vertex_handle hint;
+    for(const auto& point : lp) {
+        hint = dt.insert(point.first, hint == Delaunay_3::Vertex_handle() ? Delaunay_3::Cell_handle() : hint->cell());
+        hint->info() = point.second;
     }
 
-    // Create a Delaunay triangulation
-    // Delaunay_3 dt(lp.begin(), lp.end());
+    // Create an alpha shape (takes over the triangulation)
+    float cached = cached_alpha ? cached_alpha->load() : -1.0f;
+    bool search = (mode == ALPHA_OPTIMAL) || (mode == ALPHA_CACHED && cached < 0);
+    FT initial_alpha = 0;
+    if(mode == ALPHA_FIXED) initial_alpha = alpha;
+    else if(mode == ALPHA_CACHED && !search) initial_alpha = cached;
 
-    // Create an alpha shape
-    Alpha_shape_3 as(lp.begin(), lp.end());
+    Alpha_shape_3 as(dt, initial_alpha);
     assert(as.dimension() == 3);
     
     // find optimal alpha values
-    Alpha_iterator opt = as.find_optimal_alpha(1);
-    if(opt != as.alpha_end()) {
-        as.set_alpha((*opt));
+    if(search) {
+        Alpha_iterator opt = as.find_optimal_alpha(1);
+        if(opt != as.alpha_end()) {
+            as.set_alpha((*opt));
+            if(mode == ALPHA_CACHED && cached_alpha) {
+                // round up so meshing at the stored alpha keeps the critical simplex
+                float stored = (float) (*opt);
+                if(stored < *opt) stored = std::nextafter(stored, INFINITY);
+                *cached_alpha = stored;
+            }
+        }
     }
 
-    std::list<Edge>  as_edges;
-    std::list<Facet> as_facets;
-    std::list<Cell_handle>  as_cells;
+    std::vector<Edge>&        as_edges = scratch.edges;
+    std::vector<Facet>&       as_facets = scratch.facets;
+    std::vector<Cell_handle>& as_cells = scratch.cells;
+    as_edges.clear();
+    as_facets.clear();
+    as_cells.clear();
+
     as.get_alpha_shape_edges(std::back_inserter(as_edges),
                         Alpha_shape_3::REGULAR);
     as.get_alpha_shape_edges(std::back_inserter(as_edges),
@@ -80,18 +118,18 @@ Triangulation::Mesh Triangulation::AlphaShape(const std::vector<Mass>& masses) {
     as.get_alpha_shape_cells(std::back_inserter(as_cells),
                         Alpha_shape_3::INTERIOR);
 
+    edges.reserve(as_edges.size());
+    facets.reserve(as_facets.size());
+    cells.reserve(as_cells.size());
 
     for(const auto& e : as_edges) {
-        // std::cout << e.second << ", " << e.third << std::endl;
         uint16_t v0 = e.first->vertex(e.second)->info();
         uint16_t v1 = e.first->vertex(e.third)->info();
         float dist = (masses[v0].pos - masses[v1].pos).norm();
-        Simplex::Edge edge = {v0, v1, dist};
-        edges.push_back(edge);
+        edges.push_back({v0, v1, dist});
     }
 
     for(const auto& f : as_facets) {
-        // std::cout << e.second << ", " << e.third << std::endl;
         uint16_t v0 = f.first->vertex((f.second+1)%4)->info();
         uint16_t v1 = f.first->vertex((f.second+2)%4)->info();
         uint16_t v2 = f.first->vertex((f.second+3)%4)->info();
@@ -99,8 +137,7 @@ Triangulation::Mesh Triangulation::AlphaShape(const std::vector<Mass>& masses) {
         isBoundaryVertexFlags[v0] = true;
         isBoundaryVertexFlags[v1] = true;
         isBoundaryVertexFlags[v2] = true;
-        Simplex::Facet facet = {v0, v1, v2};
-        facets.push_back(facet);
+        facets.push_back({v0, v1, v2});
     }
 
     for(const auto& c : as_cells) {
@@ -109,8 +146,7 @@ Triangulation::Mesh Triangulation::AlphaShape(const std::vector<Mass>& masses) {
         uint16_t v2 = c->vertex(2)->info();
         uint16_t v3 = c->vertex(3)->info();
 
-        Simplex::Cell cell = {v0, v1, v2, v3};
-        cells.push_back(cell);
+        cells.push_back({v0, v1, v2, v3});
     }
 
     return {edges, facets, cells, isBoundaryVertexFlags};
@@ -143,50 +143,4 @@ Mesh KNN(const std::vector<Mass>& masses, uint16_t K)
     return {edges};
 }
 
-
-Mesh KNN_CPU(const std::vector<Mass>& masses, uint16_t K)
-{
-    unsigned int num_masses = masses.size();
-
-    std::vector<std::vector<float>> distances(num_masses, std::vector<float>(num_masses));
-    for(size_t i = 0; i < num_masses; i++) {
-        Eigen::Vector3f p1 = masses[i].pos;
-        for(size_t j = 0; j < num_masses; j++) {
-            Eigen::Vector3f p2 = masses[j].pos;
-            distances[i][j] = distances[j][i] = (p1-p2).norm();
-        }
-    }
-
-    std::vector<std::vector<std::pair<uint16_t,float>>> KNN(
-        num_masses, std::vector<std::pair<uint16_t, float>>(K));
-
-    for(size_t i = 0; i < distances.size(); i++) {
-        std::vector<std::pair<uint16_t, float>> neighbors(distances.size());
-        for (size_t j = 0; j < distances.size(); j++) {
-            if(distances[i][j] == 0.0f)
-                neighbors[j] = {j, std::numeric_limits<double>::infinity()};
-            else
-                neighbors[j] = {j, distances[i][j]};
-        }
-        sort(neighbors.begin(), neighbors.end(), [](const std::pair<uint, float>& a, const std::pair<uint, float>& b) {
-            return a.second < b.second;
-        });
-        neighbors.resize(K);
-
-        KNN[i] = neighbors;
-    }
-
-    std::vector<Simplex::Edge> edges;
-    for (uint16_t i = 0; i < masses.size(); i++) {
-        auto neighbors = KNN[i];
-
-        for (auto neighbor : neighbors) {
-            Simplex::Edge edge = {i, neighbor.first, neighbor.second};
-            edges.push_back(edge);
-        }
-    }
-
-    return {edges};
-}
-
 }
\ No newline at end of file
@@ -0,0 +1,210 @@
+#include <cmath>
+#include <limits>
+#include <thread>
+#include <algorithm>
+
+#include "triangulation.h"
+
+/*
+ * CPU K nearest neighbor spring builder.
+ * Masses are bucketed into a uniform grid (counting sort into flat arrays),
+ * each query walks rings of cells outward and keeps its K best candidates
+ * in a bounded sorted buffer, stopping once no unvisited cell can hold a closer
+ * point. Queries are independent and split across threads.
+ */
+
+namespace Triangulation {
+
+namespace {
+
+struct Neighbor {
+    float dist;
+    uint16_t id;
+    bool operator<(const Neighbor& o) const {
+        return dist < o.dist || (dist == o.dist && id < o.id);
+    }
+};
+
+struct Grid {
+    Eigen::Vector3f lo;
+    float cell;
+    int nx, ny, nz;
+    std::vector<uint32_t> cellStart; // prefix sums, size nx*ny*nz+1
+    std::vector<uint16_t> ids;       // mass indices sorted by cell
+    std::vector<float> points;       // xyz of ids, packed in the same order
+
+    int clampCell(float u, int n) const {
+        return std::min(std::max((int) u, 0), n-1);
+    }
+
+    void cellOf(const Eigen::Vector3f& p, int& i, int& j, int& k) const {
+        Eigen::Vector3f u = (p - lo) / cell;
+        i = clampCell(u.x(), nx);
+        j = clampCell(u.y(), ny);
+        k = clampCell(u.z(), nz);
+    }
+};
+
+Grid BuildGrid(const std::vector<Mass>& masses, uint16_t K) {
+    Grid grid;
+    Eigen::Vector3f hi;
+    grid.lo = hi = masses[0].pos;
+    for(const Mass& m : masses) {
+        grid.lo = grid.lo.cwiseMin(m.pos);
+        hi = hi.cwiseMax(m.pos);
+    }
+    Eigen::Vector3f extent = (hi - grid.lo).cwiseMax(1e-3f);
+
+    // about K/2 masses per cell, so a query usually finishes in ring 1
+    float volume = extent.x() * extent.y() * extent.z();
+    grid.cell = std::cbrt(volume * std::max(K / 2, 1) / masses.size());
+    grid.nx = std::min((int) (extent.x() / grid.cell) + 1, 1024);
+    grid.ny = std::min((int) (extent.y() / grid.cell) + 1, 1024);
+    grid.nz = std::min((int) (extent.z() / grid.cell) + 1, 1024);
+
+    std::vector<uint32_t> cellIdx(masses.size());
+    grid.cellStart.assign(grid.nx * grid.ny * grid.nz + 1, 0);
+    for(size_t m = 0; m < masses.size(); m++) {
+        int i, j, k;
+        grid.cellOf(masses[m].pos, i, j, k);
+        cellIdx[m] = (k*grid.ny + j)*grid.nx + i;
+        grid.cellStart[cellIdx[m]+1]++;
+    }
+    for(size_t c = 1; c < grid.cellStart.size(); c++) {
+        grid.cellStart[c] += grid.cellStart[c-1];
+    }
+    std::vector<uint32_t> fill(grid.cellStart.begin(), grid.cellStart.end()-1);
+    grid.ids.resize(masses.size());
+    grid.points.resize(3 * masses.size());
+    for(size_t m = 0; m < masses.size(); m++) {
+        uint32_t s = fill[cellIdx[m]]++;
+        grid.ids[s] = m;
+        grid.points[3*s]   = masses[m].pos.x();
+        grid.points[3*s+1] = masses[m].pos.y();
+        grid.points[3*s+2] = masses[m].pos.z();
+    }
+    return grid;
+}
+
+// Squared distance from p to the box spanning cells [i0,i1]x[j0,j1]x[k0,k1]
+float BoxDist2(const Grid& grid, const Eigen::Vector3f& p, int i0, int i1, int j0, int j1, int k0, int k1) {
+    Eigen::Vector3f bmin = grid.lo + grid.cell * Eigen::Vector3f(i0, j0, k0);
+    Eigen::Vector3f bmax = grid.lo + grid.cell * Eigen::Vector3f(i1+1, j1+1, k1+1);
+    Eigen::Vector3f d = (bmin - p).cwiseMax(p - bmax).cwiseMax(0.0f);
+    return d.squaredNorm();
+}
+
+// Writes the K nearest points to p, excluding p itself, into out (sorted by
+// distance), returns how many were found
+uint16_t Query(const Grid& grid, const Eigen::Vector3f& p, uint16_t K, Neighbor* out) {
+    int ci, cj, ck;
+    grid.cellOf(p, ci, cj, ck);
+    int maxRing = std::max({ci, cj, ck, grid.nx-1-ci, grid.ny-1-cj, grid.nz-1-ck});
+
+    // distances are squared until the final sort
+    uint16_t count = 0;
+    for(int r = 0; r <= maxRing; r++) {
+        for(int k = std::max(ck-r, 0); k <= std::min(ck+r, grid.nz-1); k++) {
+            for(int j = std::max(cj-r, 0); j <= std::min(cj+r, grid.ny-1); j++) {
+                bool shellRow = (std::abs(k-ck) == r || std::abs(j-cj) == r);
+                for(int i = ci-r; i <= ci+r; i += (shellRow || r == 0) ? 1 : 2*r) {
+                    if(i < 0 || i >= grid.nx) continue;
+                    if(count == K && BoxDist2(grid, p, i, i, j, j, k, k) >= out[K-1].dist) continue;
+
+                    int c = (k*grid.ny + j)*grid.nx + i;
+                    for(uint32_t s = grid.cellStart[c]; s < grid.cellStart[c+1]; s++) {
+                        float dx = grid.points[3*s] - p.x(),
+                              dy = grid.points[3*s+1] - p.y(),
+                              dz = grid.points[3*s+2] - p.z();
+                        float dist = dx*dx + dy*dy + dz*dz;
+                        // coincident points (including q itself) make degenerate springs
+                        if(dist == 0.0f) continue;
+                        Neighbor n = {dist, grid.ids[s]};
+                        if(count == K && !(n < out[K-1])) continue;
+
+                        // insertion into the sorted candidate list
+                        int pos = (count < K) ? count++ : K-1;
+                        while(pos > 0 && n < out[pos-1]) {
+                            out[pos] = out[pos-1];
+                            pos--;
+                        }
+                        out[pos] = n;
+                    }
+                }
+            }
+        }
+        if(count < K) continue;
+
+        // unvisited points lie outside the visited box, on a side that has
+        // cells left; stop when none of those sides can beat the K-th best
+        float bound = INFINITY;
+        Eigen::Vector3f bmin = grid.lo + grid.cell * Eigen::Vector3f(ci-r, cj-r, ck-r);
+        Eigen::Vector3f bmax = grid.lo + grid.cell * Eigen::Vector3f(ci+r+1, cj+r+1, ck+r+1);
+        if(ci-r > 0)         bound = std::min(bound, p.x() - bmin.x());
+        if(cj-r > 0)         bound = std::min(bound, p.y() - bmin.y());
+        if(ck-r > 0)         bound = std::min(bound, p.z() - bmin.z());
+        if(ci+r < grid.nx-1) bound = std::min(bound, bmax.x() - p.x());
+        if(cj+r < grid.ny-1) bound = std::min(bound, bmax.y() - p.y());
+        if(ck+r < grid.nz-1) bound = std::min(bound, bmax.z() - p.z());
+        if(out[K-1].dist <= bound * bound) break;
+    }
+    for(uint16_t s = 0; s < count; s++) out[s].dist = std::sqrt(out[s].dist);
+    return count;
+}
+
+}
+
+Mesh KNN_CPU(const std::vector<Mass>& masses, uint16_t K, unsigned int num_threads)
+{
+    std::vector<Simplex::Edge> edges;
+    size_t num_masses = masses.size();
+    if(num_masses < 2 || K == 0) return {edges, {}, {}, {}};
+
+    Grid grid = BuildGrid(masses, K);
+
+    std::vector<Neighbor> neighbors(num_masses * K);
+    std::vector<uint16_t> counts(num_masses);
+
+    auto querySubset = [&](size_t begin, size_t end) {
+        for(size_t i = begin; i < end; i++) {
+            counts[i] = Query(grid, masses[i].pos, K, &neighbors[i * K]);
+        }
+    };
+
+    if(num_threads == 0) num_threads = std::max(1u, std::thread::hardware_concurrency());
+    // below a few hundred queries per thread the spawn cost dominates
+    num_threads = std::min<size_t>(num_threads, std::max<size_t>(1, num_masses / 256));
+
+    if(num_threads == 1) {
+        querySubset(0, num_masses);
+    } else {
+        std::vector<std::thread> threads;
+        size_t chunk = (num_masses + num_threads - 1) / num_threads;
+        for(size_t begin = 0; begin < num_masses; begin += chunk) {
+            threads.emplace_back(querySubset, begin, std::min(begin + chunk, num_masses));
+        }
+        for(std::thread& t : threads) t.join();
+    }
+
+    // i->j and j->i describe the same spring, keep the one from the lower index
+    auto contains = [&](size_t i, uint16_t id) {
+        const Neighbor* n = &neighbors[i * K];
+        for(uint16_t s = 0; s < counts[i]; s++) {
+            if(n[s].id == id) return true;
+        }
+        return false;
+    };
+
+    edges.reserve(num_masses * K);
+    for(size_t i = 0; i < num_masses; i++) {
+        const Neighbor* n = &neighbors[i * K];
+        for(uint16_t s = 0; s < counts[i]; s++) {
+            if(n[s].id < i && contains(n[s].id, i)) continue;
+            edges.push_back({(uint16_t) i, n[s].id, n[s].dist});
+        }
+    }
+
+    return {edges, {}, {}, {}};
+}
+
+}
@@ -0,0 +1,241 @@
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <algorithm>
+#include <Eigen/Geometry>
+
+#include "triangulation.h"
+
+/*
+ * Body-centered-cubic lattice mesher.
+ * Every non-air mass is snapped to its nearest BCC site (cube corners and
+ * cube centers of spacing h); the mass closest to a site represents it.
+ * Springs join occupied nearest (corner-center) and second nearest
+ * (axis aligned) neighbours. Cells are the tetrahedra of the standard BCC
+ * tetrahedralization: two face-adjacent centers plus one edge of the face
+ * they share. Boundary facets are tetrahedron faces owned by a single cell,
+ * ordered so their normal (v2-v1)x(v3-v1) points out of the body.
+ * Everything is a fixed stencil over the occupied sites, so the cost is
+ * linear in the number of masses.
+ */
+
+namespace {
+
+struct SiteGrid {
+    int nx, ny, nz;
+    std::vector<int>   mass;  // representative mass index, -1 when empty
+    std::vector<float> dist2; // squared distance of the representative
+
+    // keeps the allocation when the grid shrinks
+    void reset(int x, int y, int z) {
+        nx = x; ny = y; nz = z;
+        mass.assign(nx*ny*nz, -1);
+        dist2.assign(nx*ny*nz, INFINITY);
+    }
+
+    int at(int i, int j, int k) const {
+        if(i < 0 || j < 0 || k < 0 || i >= nx || j >= ny || k >= nz) return -1;
+        return mass[(k*ny + j)*nx + i];
+    }
+
+    void offer(int i, int j, int k, int m, float d2) {
+        size_t idx = (k*ny + j)*nx + i;
+        if(d2 < dist2[idx]) {
+            dist2[idx] = d2;
+            mass[idx] = m;
+        }
+    }
+};
+
+// Output clouds fill only part of their bounding box, so the volume is
+// measured on a coarse occupancy grid with about one cell per mass and the
+// spacing chosen so the occupied volume holds about one site per mass.
+float LatticeSpacing(const std::vector<Mass>& masses, const Eigen::Vector3f& lo,
+                     const Eigen::Vector3f& extent, uint count) {
+    float cell = std::cbrt(extent.x() * extent.y() * extent.z() / count);
+    int nx = (int) (extent.x() / cell) + 1,
+        ny = (int) (extent.y() / cell) + 1,
+        nz = (int) (extent.z() / cell) + 1;
+    std::vector<bool> occupied(nx*ny*nz, false);
+    uint occupiedCount = 0;
+    for(const Mass& m : masses) {
+        if(m.material == materials::air) continue;
+        Eigen::Vector3f u = (m.pos - lo) / cell;
+        int i = std::min((int) u.x(), nx-1), j = std::min((int) u.y(), ny-1), k = std::min((int) u.z(), nz-1);
+        std::vector<bool>::reference o = occupied[(k*ny + j)*nx + i];
+        if(!o) occupiedCount++;
+        o = true;
+    }
+    float volume = occupiedCount * cell * cell * cell;
+    return std::cbrt(2.0f * volume / count);
+}
+
+// Per thread buffers reused across meshes, so batched builds only allocate
+// on the first robot a worker meshes (and when a cloud needs a larger grid)
+struct LatticeScratch {
+    SiteGrid corners, centers;
+    std::unordered_map<uint64_t, uint32_t> faceCount;
+    std::vector<Triangulation::Simplex::Facet> cellFaces;
+};
+
+thread_local LatticeScratch scratch;
+
+uint64_t FaceKey(uint16_t a, uint16_t b, uint16_t c) {
+    if(a > b) std::swap(a, b);
+    if(b > c) std::swap(b, c);
+    if(a > b) std::swap(a, b);
+    return ((uint64_t) a << 32) | ((uint64_t) b << 16) | (uint64_t) c;
+}
+
+}
+
+Triangulation::Mesh Triangulation::Lattice(const std::vector<Mass>& masses, float spacing) {
+    std::vector<Simplex::Edge> edges;
+    std::vector<Simplex::Facet> facets;
+    std::vector<Simplex::Cell> cells;
+    std::vector<bool> isBoundaryVertexFlags(masses.size(), false);
+
+    Eigen::Vector3f lo, hi;
+    uint count = 0;
+    for(const Mass& m : masses) {
+        if(m.material == materials::air) continue;
+        if(count == 0) lo = hi = m.pos;
+        lo = lo.cwiseMin(m.pos);
+        hi = hi.cwiseMax(m.pos);
+        count++;
+    }
+    if(count < 4) {
+        return {edges, facets, cells, isBoundaryVertexFlags};
+    }
+
+    Eigen::Vector3f extent = (hi - lo).cwiseMax(1e-3f);
+    if(spacing <= 0.0f) {
+        spacing = LatticeSpacing(masses, lo, extent, count);
+    }
+
+    int nx = (int) (extent.x() / spacing) + 2,
+        ny = (int) (extent.y() / spacing) + 2,
+        nz = (int) (extent.z() / spacing) + 2;
+    SiteGrid& corners = scratch.corners;
+    SiteGrid& centers = scratch.centers;
+    corners.reset(nx, ny, nz);
+    centers.reset(nx, ny, nz);
+
+    for(uint m = 0; m < masses.size(); m++) {
+        if(masses[m].material == materials::air) continue;
+        Eigen::Vector3f u = (masses[m].pos - lo) / spacing;
+
+        int ci = (int) std::lround(u.x()), cj = (int) std::lround(u.y()), ck = (int) std::lround(u.z());
+        int bi = (int) std::floor(u.x()), bj = (int) std::floor(u.y()), bk = (int) std::floor(u.z());
+        float dc = (u - Eigen::Vector3f(ci, cj, ck)).squaredNorm();
+        float db = (u - Eigen::Vector3f(bi + 0.5f, bj + 0.5f, bk + 0.5f)).squaredNorm();
+
+        if(dc <= db) corners.offer(ci, cj, ck, m, dc);
+        else         centers.offer(bi, bj, bk, m, db);
+    }
+
+    auto addEdge = [&](int a, int b) {
+        if(a < 0 || b < 0) return;
+        uint16_t v1 = masses[a].id, v2 = masses[b].id;
+        edges.push_back({v1, v2, (masses[a].pos - masses[b].pos).norm()});
+    };
+
+    // Springs: half stencil so every lattice edge is visited once
+    edges.reserve(7 * count);
+    for(int k = 0; k < nz; k++) {
+        for(int j = 0; j < ny; j++) {
+            for(int i = 0; i < nx; i++) {
+                int c = centers.at(i, j, k);
+                if(c >= 0) {
+                    for(int d = 0; d < 8; d++) {
+                        addEdge(c, corners.at(i + (d & 1), j + ((d >> 1) & 1), k + ((d >> 2) & 1)));
+                    }
+                    addEdge(c, centers.at(i+1, j, k));
+                    addEdge(c, centers.at(i, j+1, k));
+                    addEdge(c, centers.at(i, j, k+1));
+                }
+                int q = corners.at(i, j, k);
+                if(q >= 0) {
+                    addEdge(q, corners.at(i+1, j, k));
+                    addEdge(q, corners.at(i, j+1, k));
+                    addEdge(q, corners.at(i, j, k+1));
+                }
+            }
+        }
+    }
+
+    // Cells: for each pair of centers adjacent along an axis, one
+    // tetrahedron per edge of the square face the two cubes share
+    std::unordered_map<uint64_t, uint32_t>& faceCount = scratch.faceCount;
+    std::vector<Simplex::Facet>& cellFaces = scratch.cellFaces;
+    faceCount.clear();
+    cellFaces.clear();
+    faceCount.reserve(16 * count);
+
+    // Faces are stored facing away from the cell's remaining vertex, using
+    // the lattice site positions so mass jitter cannot flip them
+    uint16_t cellIds[4];
+    Eigen::Vector3f cellSites[4];
+    auto addFace = [&](int a, int b, int c, int opposite) {
+        Eigen::Vector3f normal = (cellSites[b] - cellSites[a]).cross(cellSites[c] - cellSites[a]);
+        if(normal.dot(cellSites[opposite] - cellSites[a]) > 0.0f) std::swap(b, c);
+        uint32_t& n = faceCount[FaceKey(cellIds[a], cellIds[b], cellIds[c])];
+        if(n++ == 0) cellFaces.push_back({cellIds[a], cellIds[b], cellIds[c]});
+    };
+
+    int face[4][2] = {{0,0}, {1,0}, {1,1}, {0,1}};
+    for(int k = 0; k < nz; k++) {
+        for(int j = 0; j < ny; j++) {
+            for(int i = 0; i < nx; i++) {
+                int c0 = centers.at(i, j, k);
+                if(c0 < 0) continue;
+                for(int axis = 0; axis < 3; axis++) {
+                    int o[3] = {i, j, k};
+                    o[axis]++;
+                    int c1 = centers.at(o[0], o[1], o[2]);
+                    if(c1 < 0) continue;
+
+                    // corners of the shared face lie on plane o[axis]
+                    int b = (axis + 1) % 3, d = (axis + 2) % 3;
+                    int q[4];
+                    Eigen::Vector3f qSite[4];
+                    for(int s = 0; s < 4; s++) {
+                        int p[3] = {o[0], o[1], o[2]};
+                        p[b] += face[s][0];
+                        p[d] += face[s][1];
+                        q[s] = corners.at(p[0], p[1], p[2]);
+                        qSite[s] = Eigen::Vector3f(p[0], p[1], p[2]);
+                    }
+
+                    cellSites[0] = Eigen::Vector3f(i + 0.5f, j + 0.5f, k + 0.5f);
+                    cellSites[1] = Eigen::Vector3f(o[0] + 0.5f, o[1] + 0.5f, o[2] + 0.5f);
+                    cellIds[0] = masses[c0].id;
+                    cellIds[1] = masses[c1].id;
+                    for(int s = 0; s < 4; s++) {
+                        int qa = q[s], qb = q[(s+1) % 4];
+                        if(qa < 0 || qb < 0) continue;
+                        cellIds[2] = masses[qa].id;
+                        cellIds[3] = masses[qb].id;
+                        cellSites[2] = qSite[s];
+                        cellSites[3] = qSite[(s+1) % 4];
+                        cells.push_back({cellIds[0], cellIds[1], cellIds[2], cellIds[3]});
+                        addFace(0, 1, 2, 3);
+                        addFace(0, 1, 3, 2);
+                        addFace(0, 2, 3, 1);
+                        addFace(1, 2, 3, 0);
+                    }
+                }
+            }
+        }
+    }
+
+    for(const Simplex::Facet& f : cellFaces) {
+        if(faceCount[FaceKey(f.v1, f.v2, f.v3)] != 1) continue;
+        isBoundaryVertexFlags[f.v1] = true;
+        isBoundaryVertexFlags[f.v2] = true;
+        isBoundaryVertexFlags[f.v3] = true;
+        facets.push_back(f);
+    }
+
+    return {edges, facets, cells, isBoundaryVertexFlags};
+}
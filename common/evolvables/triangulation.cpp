@@ -0,0 +1,36 @@
+#include <thread>
+
+#include "triangulation.h"
+#include "parallel.h"
+#include "perf_counters.h"
+#include "trace.h"
+
+Triangulation::Mesh Triangulation::Triangulate(const std::vector<Mass>& masses, const MeshOptions& options) {
+    Mesh mesh;
+    if(options.type == MESH_LATTICE) {
+        util::perf::Scope lattice_scope("nn.lattice");
+        mesh = Lattice(masses, options.lattice_spacing);
+        lattice_scope.setSprings(mesh.edges.size());
+    } else {
+        util::perf::Scope alpha_scope("nn.alphashape");
+        mesh = AlphaShape(masses, options.alpha_mode, options.alpha, options.cached_alpha);
+        alpha_scope.setSprings(mesh.edges.size());
+    }
+    return mesh;
+}
+
+std::vector<Triangulation::Mesh> Triangulation::Batch(const std::vector<const std::vector<Mass>*>& mass_groups,
+                                                      const MeshOptions& options, unsigned int num_threads) {
+    TRACE_SCOPE("TriangulateBatch", "build");
+    std::vector<Mesh> meshes(mass_groups.size());
+    if(num_threads == 0) num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    // one robot per claim: alpha shape cost varies a lot between robots
+    util::ParallelFor(mass_groups.size(), num_threads, [&](size_t begin, size_t end) {
+        for(size_t i = begin; i < end; i++) {
+            TRACE_SCOPE("Triangulate", "build");
+            meshes[i] = Triangulate(*mass_groups[i], options);
+        }
+    });
+    return meshes;
+}
@@ -1,8 +1,10 @@
 #ifndef __TRIANGULATION_H__
 #define __TRIANGULATION_H__
 
+#include <atomic>
 #include <vector>
 #include "mass.h"
+#include "structs.h"
 
 namespace Triangulation {
     namespace Simplex {
@@ -31,17 +33,43 @@ namespace Triangulation {
         std::vector<bool> isBoundaryVertexFlags;
     };
 
-    Mesh AlphaShape(const std::vector<Mass>& masses);
+    /// @brief Alpha shape of the non-air masses
+    /// @param mode - how alpha is chosen (see AlphaMode)
+    /// @param alpha - squared alpha radius used by ALPHA_FIXED
+    /// @param cached_alpha - alpha shared by ALPHA_CACHED builds, negative until the first search stores
+    ///        one (rounded up to a float, never below the optimum). Without it ALPHA_CACHED searches like
+    ///        ALPHA_OPTIMAL.
+    Mesh AlphaShape(const std::vector<Mass>& masses, AlphaMode mode = ALPHA_OPTIMAL, float alpha = 0.0f,
+                    std::atomic<float>* cached_alpha = nullptr);
+
+    /// @brief Tetrahedral mesh of the non-air masses snapped to a BCC lattice, linear in the mass count
+    /// @param spacing - lattice cube size, 0 derives it from the mass density
+    Mesh Lattice(const std::vector<Mass>& masses, float spacing = 0.0f);
 
     Mesh KNN(const std::vector<Mass>& masses, uint16_t K);
-    Mesh KNN_CPU(const std::vector<Mass>& mass_group, uint16_t K);
-
-    /// @brief Computes the K Nearest neighbors for each mass of each mass_list
-    /// @tparam T - requires variable masses
-    /// @param point_groups 
-    /// @param k 
-    /// @return vector of KNNs for each mass in each group
-    Mesh Batch(const std::vector<Mass>& mass_groups, uint16_t K);
+
+    /// @brief K nearest neighbor springs on the CPU, each spring listed once
+    /// @param num_threads - worker threads, 0 uses the hardware thread count
+    Mesh KNN_CPU(const std::vector<Mass>& masses, uint16_t K, unsigned int num_threads = 0);
+
+    struct MeshOptions {
+        MeshType type = MESH_ALPHA;
+        AlphaMode alpha_mode = ALPHA_OPTIMAL;
+        float alpha = 0.0f;
+        std::atomic<float>* cached_alpha = nullptr;
+        float lattice_spacing = 0.0f;
+    };
+
+    /// @brief Meshes one mass cloud with the backend selected in options
+    Mesh Triangulate(const std::vector<Mass>& masses, const MeshOptions& options);
+
+    /// @brief Meshes a whole population as one job. Workers pull robots from a
+    /// shared queue and keep their meshing scratch buffers between robots.
+    /// @param mass_groups - one mass cloud per robot
+    /// @param num_threads - worker threads, 0 uses the hardware thread count
+    /// @return one mesh per mass group, in order
+    std::vector<Mesh> Batch(const std::vector<const std::vector<Mass>*>& mass_groups,
+                            const MeshOptions& options, unsigned int num_threads = 0);
 }
 
 #endif
@@ -4,6 +4,7 @@
 #include <random>
 #include <map>
 #include "util.h"
+#include "perf_counters.h"
 
 #include <cub/device/device_segmented_radix_sort.cuh>
 
@@ -110,8 +111,10 @@ void Simulator::Initialize(Config::Simulator config) {
 
 
 void Simulator::_initialize() { //uint maxMasses, uint maxSprings) {
+	SIM_TIMER(&m_stats, initialize);
 	maxEnvs = 1;
 	m_total_time = 0.0f;
+	m_springsChanged = false;
 	
 	if(initialized) freeMemory();
 	initialized = true;
@@ -205,6 +208,7 @@ ElementTracker Simulator::SetElement(const Element& element) {
 
 std::vector<ElementTracker> Simulator::SetElements(const std::vector<Element>& elements) {
 	std::vector<ElementTracker> trackers;
+	if(elements.size() == 0) return trackers;
 
 	// cudaFuncAttributes attr;
 	// cudaFuncGetAttributes(&attr, integrateBodiesStresses);
@@ -240,6 +244,9 @@ std::vector<ElementTracker> Simulator::SetElements(const std::vector<Element>& e
 
 	_initialize();
 
+	SIM_TIMER(&m_stats, pack);
+	util::perf::Scope pack_scope("sim.pack");
+
 	numElements = 0; numMasses = 0; numSprings = 0; numFaces = 0; numCells = 0;
 	for(uint i = 0; i < elements.size(); i++) {
 		trackers.push_back(AllocateElement(elements[i]));
@@ -363,6 +370,13 @@ std::vector<ElementTracker> Simulator::SetElements(const std::vector<Element>& e
 
 	gpuErrchk( cudaPeekAtLastError() );
 
+	pack_scope.setSprings(numSprings);
+	SIM_COUNT(&m_stats, bytesPacked,
+		numMasses  * (8*sizeof(float) + sizeof(uint32_t)) +
+		numSprings * (2*sizeof(ushort) + sizeof(uint32_t) + sizeof(uint8_t) + sizeof(float) + sizeof(uint)) +
+		numFaces   * 4*sizeof(ushort) +
+		numCells   * (4*sizeof(ushort) + 5*sizeof(float)));
+
 	return trackers;
 }
 
@@ -426,7 +440,7 @@ void Simulator::Simulate(float sim_duration, bool trackStresses, bool trace, std
 	setSimOpts(opt);
 	
 	while(simTimeRemaining > 0.0f) {
-		integrateBodies(m_dData, numElements, opt, m_total_time, step_count, trackStresses);
+		integrateBodies(m_dData, numElements, opt, m_total_time, step_count, trackStresses, &m_stats);
 		gpuErrchk( cudaPeekAtLastError() );
 
 		if(trace) {
@@ -535,14 +549,17 @@ Element Simulator::Collect(const ElementTracker& tracker) {
 }
 
 std::vector<Element> Simulator::Collect(const std::vector<ElementTracker>& trackers) {
+	SIM_TIMER(&m_stats, collect);
+	PERF_SCOPE("sim.collect", numSprings);
+	SIM_COUNT(&m_stats, bytesCollected,
+		numMasses  * 8*sizeof(float) +
+		numSprings * (sizeof(float) + sizeof(uint32_t) + 2*sizeof(ushort) + sizeof(float)));
+
 	cudaMemcpy(m_hPos,m_dData.dPos,numMasses*4*sizeof(float),cudaMemcpyDeviceToHost);
 	cudaMemcpy(m_hVel,m_dData.dVel,numMasses*4*sizeof(float),cudaMemcpyDeviceToHost);
 	cudaMemcpy(m_hSpringStresses,   m_dData.dSpringStresses,   numSprings*sizeof(float), cudaMemcpyDeviceToHost);
 
-	cudaMemcpy(m_hSpringMatEncodings, m_dData.dSpringMatEncodings, numSprings*sizeof(uint32_t), cudaMemcpyDeviceToHost);
-	cudaMemcpy(m_hPairs, m_dData.dPairs, numSprings*2*sizeof(ushort), cudaMemcpyDeviceToHost);
-	cudaMemcpy(m_hLbars, m_dData.dLbars, numSprings * sizeof(float),  cudaMemcpyDeviceToHost);
-
+	collectSprings();
 	
 	for(uint i = 0; i < numMasses; i++) {
 		float3 pos = {m_hPos[4*i], m_hPos[4*i+1], m_hPos[4*i+2]};
@@ -553,13 +570,6 @@ std::vector<Element> Simulator::Collect(const std::vector<ElementTracker>& track
 		massBuf[i].vel = Eigen::Vector3f(vel.x,vel.y,vel.z);
 	}
 
-	for(uint i = 0; i < numSprings; i++) {
-		springBuf[i].m0 = m_hPairs[2*i];
-		springBuf[i].m1 = m_hPairs[2*i+1];
-		springBuf[i].mean_length = m_hLbars[i];
-		springBuf[i].material = materials::decode(m_hSpringMatEncodings[i]);
-	}
-
 	#if defined(FULL_STRESS) && defined(WRITE_STRESS)
 	std::vector<std::tuple<uint, float, uint, uint>> stressHistory;
 
@@ -579,6 +589,66 @@ std::vector<Element> Simulator::Collect(const std::vector<ElementTracker>& track
 	return elements;
 }
 
+// Devo rewires springs on the device only, this brings the host copy back
+// in line
+void Simulator::collectSprings() {
+	cudaMemcpy(m_hSpringMatEncodings, m_dData.dSpringMatEncodings, numSprings*sizeof(uint32_t), cudaMemcpyDeviceToHost);
+	cudaMemcpy(m_hPairs, m_dData.dPairs, numSprings*2*sizeof(ushort), cudaMemcpyDeviceToHost);
+	cudaMemcpy(m_hLbars, m_dData.dLbars, numSprings * sizeof(float),  cudaMemcpyDeviceToHost);
+
+	for(uint i = 0; i < numSprings; i++) {
+		springBuf[i].m0 = m_hPairs[2*i];
+		springBuf[i].m1 = m_hPairs[2*i+1];
+		springBuf[i].mean_length = m_hLbars[i];
+		springBuf[i].material = materials::decode(m_hSpringMatEncodings[i]);
+	}
+	m_springsChanged = false;
+}
+
+// Copies back positions and velocities only, cheap enough to call every
+// few hundred steps while waiting for elements to settle. Springs are only
+// copied back after devo has rewired them. Muscle springs are left out of
+// the strain since actuation keeps changing their length.
+std::vector<ElementMotion> Simulator::Motion(const std::vector<ElementTracker>& trackers) {
+	SIM_TIMER(&m_stats, collect);
+	SIM_COUNT(&m_stats, bytesCollected, numMasses * 8*sizeof(float));
+
+	if(m_springsChanged) collectSprings();
+	cudaMemcpy(m_hPos,m_dData.dPos,numMasses*4*sizeof(float),cudaMemcpyDeviceToHost);
+	cudaMemcpy(m_hVel,m_dData.dVel,numMasses*4*sizeof(float),cudaMemcpyDeviceToHost);
+
+	std::vector<ElementMotion> motion(trackers.size());
+	for(size_t e = 0; e < trackers.size(); e++) {
+		const ElementTracker& tracker = trackers[e];
+		uint first = tracker.mass_begin - massBuf;
+
+		double kinetic = 0.0;
+		uint massCount = 0;
+		for(Mass* m = tracker.mass_begin; m < tracker.mass_end; m++) {
+			if(m->material == materials::air) continue;
+			uint i = m - massBuf;
+			kinetic += 0.5 * (m_hVel[4*i]*m_hVel[4*i] + m_hVel[4*i+1]*m_hVel[4*i+1] + m_hVel[4*i+2]*m_hVel[4*i+2]);
+			massCount++;
+		}
+
+		double strain = 0.0;
+		uint springCount = 0;
+		for(Spring* s = tracker.spring_begin; s < tracker.spring_end; s++) {
+			if(s->material.dL0 != 0.0f || s->mean_length <= 0.0f) continue;
+			uint a = first + s->m0, b = first + s->m1;
+			float dx = m_hPos[4*a]   - m_hPos[4*b],
+			      dy = m_hPos[4*a+1] - m_hPos[4*b+1],
+			      dz = m_hPos[4*a+2] - m_hPos[4*b+2];
+			strain += fabsf(sqrtf(dx*dx + dy*dy + dz*dz) - s->mean_length) / s->mean_length;
+			springCount++;
+		}
+
+		motion[e].kinetic = massCount > 0 ? kinetic / massCount : 0.0f;
+		motion[e].strain = springCount > 0 ? strain / springCount : 0.0f;
+	}
+	return motion;
+}
+
 Element Simulator::CollectElement(const ElementTracker& tracker) {
 	std::vector<Mass> result_masses;
 	std::vector<Spring> result_springs;
@@ -642,12 +712,17 @@ void Simulator::Devo() {
 
 	uint numReplacedSprings = m_replacedSpringsPerElement * numElements;
 
-    key_value_sort(m_dData.dSpringStresses, m_dData.dSpringStresses_Sorted, m_dData.dSpringIDs, m_dData.dSpringIDs_Sorted, springsPerElement, numElements);
+	{
+		SIM_TIMER(&m_stats, devoSort);
+		key_value_sort(m_dData.dSpringStresses, m_dData.dSpringStresses_Sorted, m_dData.dSpringIDs, m_dData.dSpringIDs_Sorted, springsPerElement, numElements);
 
-	getRandomInterPairs(numReplacedSprings, m_dData.dRandomPairs, 0, massesPerElement-1, seed);
-	
-	cudaDeviceSynchronize();
-	gpuErrchk( cudaPeekAtLastError() );
+		getRandomInterPairs(numReplacedSprings, m_dData.dRandomPairs, 0, massesPerElement-1, seed);
+		
+		cudaDeviceSynchronize();
+		gpuErrchk( cudaPeekAtLastError() );
+	}
+
+	SIM_TIMER(&m_stats, devoReplace);
 
 	DevoOptions opt = {
 		numReplacedSprings,
@@ -660,6 +735,7 @@ void Simulator::Devo() {
 	
 	setDevoOpts(opt);
 	devoBodies(m_dData, opt, m_total_time);
+	m_springsChanged = true;
 	
 	cudaDeviceSynchronize();
 	gpuErrchk( cudaPeekAtLastError() );
@@ -5,6 +5,7 @@
 #include "element.h"
 #include "config.h"
 #include "softbodysystem.h"
+#include "sim_stats.h"
 #include <memory>
 
 // TODO: Face statistics if necessary??
@@ -16,9 +17,16 @@ struct ElementTracker {
 	Spring* spring_end;
 };
 
+// How much an element still moves, see Simulator::Motion
+struct ElementMotion {
+	float kinetic;	// mean kinetic energy per unit mass
+	float strain;	// mean relative length error of passive springs
+};
+
 class Simulator {
 	void _initialize();
 	void freeMemory();
+	void collectSprings();
 
 public:
 	Simulator() {};
@@ -34,6 +42,7 @@ public:
 	Element Collect(const ElementTracker& tracker);
 	std::vector<Element> Collect(const std::vector<ElementTracker>& trackers);
 	Element CollectElement(const ElementTracker& tracker);
+	std::vector<ElementMotion> Motion(const std::vector<ElementTracker>& trackers);
 
 
 	// void Simulate(std::vector<Mass>& masses, const std::vector<Spring>& springs);
@@ -46,9 +55,16 @@ public:
 	float getTotalTime() const { return m_total_time; }
 
 	void Reset() { m_total_time = 0.0f; }
+	// SetElements restarts the clock, set it back to continue a run
+	void setTotalTime(float t) { m_total_time = t; }
+
+	// Accumulated phase timings and counters since the last ResetStats
+	const SimStats& Stats() const { return m_stats; }
+	void ResetStats() { m_stats.Reset(); }
 
 protected:
 	bool initialized = false;
+	bool m_springsChanged = false; // devo rewired springs since the last pack or collect
 
 	std::vector<Environment> mEnvironments;
     float m_total_time = 0;
@@ -146,6 +162,8 @@ protected:
 	uint elementCount      = 0;
 
 	Config::Simulator m_config;
+
+	SimStats m_stats;
 };
 
 #endif
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "vec_math.cuh"
 #include "material.h"
+#include "sim_stats.h"
+#include "perf_counters.h"
 #include <math.h>
 #include <assert.h>
 
@@ -270,7 +272,8 @@ inline void update(float4 *__restrict__ pos, float4 *__restrict__ newPos, float4
 
 void integrateBodies(DeviceData deviceData, uint numElements,
 	SimOptions opt, 
-	float time, uint step, bool integrateForce
+	float time, uint step, bool integrateForce,
+	SimStats* stats
 	) {
 	// Calculate and store new mass states
 	
@@ -303,23 +306,42 @@ void integrateBodies(DeviceData deviceData, uint numElements,
 	uint numBlocksPreSolve = (opt.maxMasses + numThreadsPerBlockPreSolve - 1) / numThreadsPerBlockPreSolve;
 	uint numBlocksUpdate = (opt.maxMasses + numThreadsPerBlockUpdate - 1) / numThreadsPerBlockUpdate;
 
-	surfaceDragForce<<<numBlocksDrag,numThreadsPerBlockDrag,sharedMemSizeDrag>>>(
-		(float4*) deviceData.dPos, (float4*) deviceData.dNewPos, 
-		(float4*) deviceData.dVel, (ushort4*) deviceData.dFaces);
-	cudaDeviceSynchronize();
-
-	preSolve<<<numBlocksPreSolve, numThreadsPerBlockPreSolve>>>(
-		(float4*) deviceData.dPos, (float4*) deviceData.dNewPos,
-		(float4*) deviceData.dVel);
-	cudaDeviceSynchronize();
-
-	solveDistance<<<numBlocksSolve,numThreadsPerBlockSolve,sharedMemSizeSolve>>>(
-		(float4*) deviceData.dNewPos, (ushort2*)  deviceData.dPairs, 
-		(float*) deviceData.dSpringStresses, (uint8_t*) deviceData.dSpringMatIds, (float*) deviceData.dLbars,
-		time, step, integrateForce);
-	cudaDeviceSynchronize();
+	{
+		SIM_TIMER(stats, drag);
+		PERF_SCOPE("sim.drag", opt.maxSprings);
+		surfaceDragForce<<<numBlocksDrag,numThreadsPerBlockDrag,sharedMemSizeDrag>>>(
+			(float4*) deviceData.dPos, (float4*) deviceData.dNewPos, 
+			(float4*) deviceData.dVel, (ushort4*) deviceData.dFaces);
+		cudaDeviceSynchronize();
+	}
+
+	{
+		SIM_TIMER(stats, preSolve);
+		PERF_SCOPE("sim.presolve", opt.maxSprings);
+		preSolve<<<numBlocksPreSolve, numThreadsPerBlockPreSolve>>>(
+			(float4*) deviceData.dPos, (float4*) deviceData.dNewPos,
+			(float4*) deviceData.dVel);
+		cudaDeviceSynchronize();
+	}
+
+	{
+		SIM_TIMER(stats, solve);
+		PERF_SCOPE("sim.solve", opt.maxSprings);
+		solveDistance<<<numBlocksSolve,numThreadsPerBlockSolve,sharedMemSizeSolve>>>(
+			(float4*) deviceData.dNewPos, (ushort2*)  deviceData.dPairs, 
+			(float*) deviceData.dSpringStresses, (uint8_t*) deviceData.dSpringMatIds, (float*) deviceData.dLbars,
+			time, step, integrateForce);
+		cudaDeviceSynchronize();
+	}
 		
-	update<<<numBlocksUpdate,numThreadsPerBlockUpdate>>>((float4*) deviceData.dPos, (float4*) deviceData.dNewPos,
-		(float4*) deviceData.dVel);
-	cudaDeviceSynchronize();
+	{
+		SIM_TIMER(stats, update);
+		PERF_SCOPE("sim.update", opt.maxSprings);
+		update<<<numBlocksUpdate,numThreadsPerBlockUpdate>>>((float4*) deviceData.dPos, (float4*) deviceData.dNewPos,
+			(float4*) deviceData.dVel);
+		cudaDeviceSynchronize();
+	}
+
+	SIM_COUNT(stats, steps, 1);
+	SIM_COUNT(stats, springsProcessed, opt.maxSprings);
 }
\ No newline at end of file
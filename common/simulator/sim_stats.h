@@ -0,0 +1,70 @@
+#ifndef __SIM_STATS_H__
+#define __SIM_STATS_H__
+
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+// Accumulated wall times (seconds) and counters for the simulator phases.
+// Kernel launches are followed by cudaDeviceSynchronize, so host timers
+// around each launch measure the kernel itself.
+struct SimStats {
+	double initialize  = 0;
+	double pack        = 0;
+	double drag        = 0;
+	double preSolve    = 0;
+	double solve       = 0;
+	double update      = 0;
+	double devoSort    = 0;
+	double devoReplace = 0;
+	double collect     = 0;
+
+	unsigned long steps            = 0;
+	unsigned long springsProcessed = 0;
+	unsigned long bytesPacked      = 0;
+	unsigned long bytesCollected   = 0;
+
+	void Reset() { *this = SimStats(); }
+
+	double stepTime() const { return drag + preSolve + solve + update; }
+
+	std::string ToString() const {
+		char buf[512];
+		snprintf(buf, sizeof(buf),
+			"init %.3fs, pack %.3fs, drag %.3fs, presolve %.3fs, solve %.3fs, update %.3fs, "
+			"devo sort %.3fs, devo replace %.3fs, collect %.3fs | "
+			"steps %lu, springs %lu, packed %.1fMB, collected %.1fMB",
+			initialize, pack, drag, preSolve, solve, update,
+			devoSort, devoReplace, collect,
+			steps, springsProcessed, bytesPacked / 1.0e6, bytesCollected / 1.0e6);
+		return std::string(buf);
+	}
+};
+
+// Adds the lifetime of the timer to the referenced accumulator (if any)
+class ScopedSimTimer {
+	double* mTotal;
+	std::chrono::high_resolution_clock::time_point mStart;
+public:
+	ScopedSimTimer(double* total) :
+		mTotal(total), mStart(std::chrono::high_resolution_clock::now()) {}
+	~ScopedSimTimer() {
+		if(mTotal == nullptr) return;
+		*mTotal += std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - mStart).count();
+	}
+};
+
+// stats is a SimStats pointer; nullptr disables recording at runtime.
+// Build with -DNO_SIM_STATS to compile the instrumentation out
+#ifndef NO_SIM_STATS
+#define SIM_STATS_CONCAT_(a,b) a##b
+#define SIM_STATS_CONCAT(a,b) SIM_STATS_CONCAT_(a,b)
+#define SIM_TIMER(stats, field) \
+	ScopedSimTimer SIM_STATS_CONCAT(_sim_timer_, __LINE__)((stats) ? &(stats)->field : nullptr)
+#define SIM_COUNT(stats, field, n) do { if(stats) (stats)->field += (n); } while(0)
+#else
+#define SIM_TIMER(stats, field) (void) (stats)
+#define SIM_COUNT(stats, field, n) (void) (stats)
+#endif
+
+#endif
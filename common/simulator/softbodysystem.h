@@ -2,6 +2,7 @@
 #define __SOFTBODYSYSTEM_H__
 
 #include "material.h"
+#include "sim_stats.h"
 
 struct SimOptions {
 	float dt;
@@ -68,7 +69,7 @@ void setCompositeMats_encoding(float* compositeMats, uint count);
 
 void setDevoOpts(DevoOptions devoOpts);
 
-void integrateBodies(DeviceData DeviceData, uint numElements, SimOptions opt, float time, uint step, bool integrateForce = false);
+void integrateBodies(DeviceData DeviceData, uint numElements, SimOptions opt, float time, uint step, bool integrateForce = false, SimStats* stats = nullptr);
 
 void getRandomInterPairs(int N, ushort* randomPairs, int min_value, int max_value, unsigned int seed);
 
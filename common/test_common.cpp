@@ -68,5 +68,75 @@ int main(int argc, char** argv)
         std::cout << "Test Case 7: Passed" << std::endl;
     }
 
+    err = TestNNBatchForward();
+	if(err) {
+        std::cout << "Test Case 8: Failed with " << err << std::endl;
+    } else {
+        std::cout << "Test Case 8: Passed" << std::endl;
+    }
+
+    err = TestKNN();
+	if(err) {
+        std::cout << "Test Case 9: Failed with " << err << std::endl;
+    } else {
+        std::cout << "Test Case 9: Passed" << std::endl;
+    }
+
+    err = TestScreen();
+	if(err) {
+        std::cout << "Test Case 10: Failed with " << err << std::endl;
+    } else {
+        std::cout << "Test Case 10: Passed" << std::endl;
+    }
+
+    err = TestVoxelSprings();
+	if(err) {
+        std::cout << "Test Case 11: Failed with " << err << std::endl;
+    } else {
+        std::cout << "Test Case 11: Passed" << std::endl;
+    }
+
+    err = TestVoxelStrip();
+	if(err) {
+        std::cout << "Test Case 12: Failed with " << err << std::endl;
+    } else {
+        std::cout << "Test Case 12: Passed" << std::endl;
+    }
+
+    err = TestPhenotype();
+	if(err) {
+        std::cout << "Test Case 13: Failed with " << err << std::endl;
+    } else {
+        std::cout << "Test Case 13: Passed" << std::endl;
+    }
+
+    err = TestAlphaModes();
+	if(err) {
+        std::cout << "Test Case 14: Failed with " << err << std::endl;
+    } else {
+        std::cout << "Test Case 14: Passed" << std::endl;
+    }
+
+    err = TestVoxelCircles();
+	if(err) {
+        std::cout << "Test Case 15: Failed with " << err << std::endl;
+    } else {
+        std::cout << "Test Case 15: Passed" << std::endl;
+    }
+
+    err = TestNNCrossover();
+	if(err) {
+        std::cout << "Test Case 16: Failed with " << err << std::endl;
+    } else {
+        std::cout << "Test Case 16: Passed" << std::endl;
+    }
+
+    err = TestLattice();
+	if(err) {
+        std::cout << "Test Case 17: Failed with " << err << std::endl;
+    } else {
+        std::cout << "Test Case 17: Passed" << std::endl;
+    }
+
 	return 0;
 }
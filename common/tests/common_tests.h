@@ -12,6 +12,16 @@ int TestSimulator();
 int TestMatEncoding();
 int TestNNRobot();
 int TestNNBuild();
+int TestNNBatchForward();
+int TestAlphaModes();
+int TestKNN();
+int TestLattice();
+int TestScreen();
+int TestVoxelSprings();
+int TestVoxelStrip();
+int TestVoxelCircles();
+int TestNNCrossover();
+int TestPhenotype();
 int TestIntegrated();
 int TestDevo();
 int TestTransfer();
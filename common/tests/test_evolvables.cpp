@@ -3,6 +3,9 @@
 #include "VoxelRobot.h"
 #include <string>
 #include "util.h"
+#include "triangulation.h"
+#include <set>
+#include <algorithm>
 
 #include "common_tests.h"
 
@@ -66,4 +69,476 @@ int TestNNBuild() {
         printf("BUILT %u\n", (i+1)*1000);
     }
     return 0;
-}
\ No newline at end of file
+}
+// Blocked forward pass, batched and for a single robot, must match the
+// unblocked pass with a full softmax it replaced, bit for bit
+int TestNNBatchForward() {
+    Config::NNRobot nnConfig;
+    nnConfig.massCount = 300;
+    
+    NNRobot::Configure(nnConfig);
+
+    std::vector<NNRobot> batch(5);
+    for(NNRobot& R : batch) R.Randomize();
+    std::vector<NNRobot> single = batch;
+    std::vector<NNRobot> reference = batch;
+
+    NNRobot::ForwardWorkspace ws;
+    NNRobot::BatchForward(batch, 0, batch.size(), ws);
+    for(size_t r = 0; r < single.size(); r++) NNRobot::BatchForward(single, r, r+1, ws);
+    for(NNRobot& R : reference) R.ReferenceForward();
+
+    for(size_t r = 0; r < batch.size(); r++) {
+        for(const NNRobot* R : {&batch[r], &single[r]}) {
+            if(R->masses.size() != reference[r].masses.size()) return 1;
+            for(size_t i = 0; i < R->masses.size(); i++) {
+                if(R->masses[i].pos != reference[r].masses[i].pos) return 2;
+                if(R->masses[i].material != reference[r].masses[i].material) return 3;
+            }
+        }
+    }
+
+    return 0;
+}
+
+// Fixed alpha at the optimal value meshes like the search, cached alpha is
+// searched once and then reused, and Configure forgets it
+int TestAlphaModes() {
+    auto cloud = [](uint count, float scale) {
+        std::vector<Mass> masses;
+        for(uint i = 0; i < count; i++) {
+            masses.push_back(Mass(i, Eigen::Vector3f::Random() * scale, materials::bone));
+        }
+        return masses;
+    };
+    // CGAL lists the simplices in no fixed order
+    auto edgeSet = [](const Triangulation::Mesh& mesh) {
+        std::set<std::pair<uint16_t,uint16_t>> edges;
+        for(const auto& e : mesh.edges) edges.insert({std::min(e.v1, e.v2), std::max(e.v1, e.v2)});
+        return edges;
+    };
+    auto sameMesh = [&](const Triangulation::Mesh& a, const Triangulation::Mesh& b) {
+        return a.facets.size() == b.facets.size() && edgeSet(a) == edgeSet(b);
+    };
+
+    // the stored alpha must not round below the optimum, which would drop
+    // the critical simplex; about half of all clouds round down
+    std::vector<Mass> first;
+    std::atomic<float> cached(-1.0f);
+    for(int trial = 0; trial < 20; trial++) {
+        first = cloud(400, 5.0f);
+        cached = -1.0f;
+        Triangulation::Mesh optimal = Triangulation::AlphaShape(first, ALPHA_OPTIMAL);
+        if(!sameMesh(Triangulation::AlphaShape(first, ALPHA_CACHED, 0.0f, &cached), optimal)) return 1;
+        if(cached < 0.0f) return 2;
+        if(!sameMesh(Triangulation::AlphaShape(first, ALPHA_FIXED, cached), optimal)) return 3;
+        if(!sameMesh(Triangulation::AlphaShape(first, ALPHA_CACHED, 0.0f, &cached), optimal)) return 9;
+    }
+    std::vector<Mass> second = cloud(400, 2.0f);
+
+    // the second cloud reuses the first cloud's alpha
+    float alpha = cached;
+    Triangulation::Mesh reused = Triangulation::AlphaShape(second, ALPHA_CACHED, 0.0f, &cached);
+    if(cached != alpha) return 4;
+    if(!sameMesh(reused, Triangulation::AlphaShape(second, ALPHA_FIXED, alpha))) return 5;
+
+    // no cache, or a reset one, searches again
+    if(!sameMesh(Triangulation::AlphaShape(second, ALPHA_CACHED), Triangulation::AlphaShape(second, ALPHA_OPTIMAL))) return 6;
+
+    Config::NNRobot nnConfig;
+    nnConfig.alpha_mode = ALPHA_CACHED;
+    NNRobot::Configure(nnConfig);
+    std::vector<NNRobot> robots(2);
+    for(NNRobot& R : robots) R.Randomize();
+    NNRobot::BatchBuild(robots);
+    if(NNRobot::CachedAlpha() < 0.0f) return 7;
+    NNRobot::Configure(nnConfig);
+    if(NNRobot::CachedAlpha() >= 0.0f) return 8;
+
+    return 0;
+}
+
+int TestKNN() {
+    const uint16_t K = 12;
+    std::vector<Mass> masses;
+    for(uint i = 0; i < 1200; i++) {
+        masses.push_back(Mass(i, Eigen::Vector3f::Random() * 5.0f, materials::bone));
+    }
+    // coincident points must not become springs
+    masses.push_back(Mass(1200, masses[0].pos, materials::bone));
+
+    std::set<std::pair<uint16_t,uint16_t>> expected;
+    for(uint16_t i = 0; i < masses.size(); i++) {
+        std::vector<std::pair<float,uint16_t>> all;
+        for(uint16_t j = 0; j < masses.size(); j++) {
+            float dist = (masses[i].pos - masses[j].pos).norm();
+            if(dist > 0.0f) all.push_back({dist, j});
+        }
+        std::sort(all.begin(), all.end());
+        for(uint16_t s = 0; s < K; s++) {
+            expected.insert({std::min(i, all[s].second), std::max(i, all[s].second)});
+        }
+    }
+
+    for(unsigned int threads : {1u, 4u}) {
+        Triangulation::Mesh mesh = Triangulation::KNN_CPU(masses, K, threads);
+        std::set<std::pair<uint16_t,uint16_t>> found;
+        for(const auto& e : mesh.edges) {
+            if(e.v1 == e.v2) return 1;
+            if(std::abs(e.dist - (masses[e.v1].pos - masses[e.v2].pos).norm()) > 1e-5f) return 2;
+            found.insert({std::min(e.v1, e.v2), std::max(e.v1, e.v2)});
+        }
+        if(found.size() != mesh.edges.size()) return 3;
+        if(found != expected) return 4;
+    }
+
+    return 0;
+}
+
+// Lattice meshes of masses placed exactly on the BCC sites of a block of
+// unit cubes: springs, cells and boundary facets match the lattice counts,
+// and the facets form a closed surface facing outwards, so their signed
+// volume equals the volume of the cells
+int TestLattice() {
+    auto block = [](int nx, int ny, int nz) {
+        std::vector<Mass> masses;
+        for(int k = 0; k <= nz; k++)
+            for(int j = 0; j <= ny; j++)
+                for(int i = 0; i <= nx; i++)
+                    masses.push_back(Mass(masses.size(), Eigen::Vector3f(i, j, k), materials::bone));
+        for(int k = 0; k < nz; k++)
+            for(int j = 0; j < ny; j++)
+                for(int i = 0; i < nx; i++)
+                    masses.push_back(Mass(masses.size(), Eigen::Vector3f(i + 0.5f, j + 0.5f, k + 0.5f), materials::bone));
+        // air is not meshed
+        masses.push_back(Mass(masses.size(), Eigen::Vector3f(0.5f, 0.5f, 0.0f), materials::air));
+        return masses;
+    };
+    auto tetVolume = [](const Eigen::Vector3f& a, const Eigen::Vector3f& b, const Eigen::Vector3f& c, const Eigen::Vector3f& d) {
+        return (b - a).dot((c - a).cross(d - a)) / 6.0f;
+    };
+
+    struct Case { int nx, ny, nz; size_t edges, cells, facets; };
+    // two cubes share one face: an octahedron of 4 cells and 8 facets
+    for(const Case& c : {Case{2, 1, 1, 37, 4, 8}, Case{2, 2, 2, 130, 48, 48}}) {
+        std::vector<Mass> masses = block(c.nx, c.ny, c.nz);
+        Triangulation::Mesh mesh = Triangulation::Lattice(masses, 1.0f);
+        if(mesh.edges.size() != c.edges) return 1;
+        if(mesh.cells.size() != c.cells) return 2;
+        if(mesh.facets.size() != c.facets) return 3;
+        if(mesh.isBoundaryVertexFlags[masses.size() - 1]) return 4;
+
+        // every directed facet edge is matched by its reverse exactly once
+        std::multiset<std::pair<uint16_t,uint16_t>> directed;
+        for(const auto& f : mesh.facets) {
+            directed.insert({f.v1, f.v2});
+            directed.insert({f.v2, f.v3});
+            directed.insert({f.v3, f.v1});
+        }
+        for(const auto& e : directed) {
+            if(directed.count(e) != 1 || directed.count({e.second, e.first}) != 1) return 5;
+        }
+
+        float cellVolume = 0.0f, enclosed = 0.0f;
+        for(const auto& t : mesh.cells) {
+            cellVolume += std::abs(tetVolume(masses[t.v1].pos, masses[t.v2].pos, masses[t.v3].pos, masses[t.v4].pos));
+        }
+        for(const auto& f : mesh.facets) {
+            enclosed += tetVolume(Eigen::Vector3f::Zero(), masses[f.v1].pos, masses[f.v2].pos, masses[f.v3].pos);
+        }
+        if(std::abs(enclosed - cellVolume) > 1e-4f) return 6;
+    }
+
+    return 0;
+}
+
+// Pre-build screen: a solid block with muscle passes, degenerate or
+// fragmented bodies are rejected without springs
+int TestScreen() {
+    Config::NNRobot nnConfig;
+    nnConfig.screen.enabled = true;
+    NNRobot::Configure(nnConfig);
+
+    auto block = [](Eigen::Vector3f origin, Eigen::Vector3f size, Material mat, std::vector<Mass>& masses) {
+        for(uint i = 0; i < 400; i++) {
+            Eigen::Vector3f u = (Eigen::Vector3f::Random() + Eigen::Vector3f::Ones()) / 2.0f;
+            masses.push_back(Mass(masses.size(), origin + u.cwiseProduct(size), mat));
+        }
+    };
+    auto screen = [](const std::vector<Mass>& masses) {
+        NNRobot R;
+        R.masses = masses;
+        return R.Screen();
+    };
+
+    std::vector<Mass> masses;
+    block(Eigen::Vector3f::Zero(), Eigen::Vector3f(4, 3, 2), materials::adductor_muscle0, masses);
+    if(!screen(masses)) return 1;
+
+    // no muscle
+    std::vector<Mass> tissue = masses;
+    for(Mass& m : tissue) m.material = materials::tissue;
+    if(screen(tissue)) return 2;
+
+    // all air
+    std::vector<Mass> air = masses;
+    for(Mass& m : air) m.material = materials::air;
+    if(screen(air)) return 3;
+
+    // flat sheet
+    std::vector<Mass> sheet = masses;
+    for(Mass& m : sheet) m.pos.z() = 0.0f;
+    if(screen(sheet)) return 4;
+
+    // three separate pieces
+    std::vector<Mass> pieces;
+    for(int p = 0; p < 3; p++) {
+        block(Eigen::Vector3f(10.0f * p, 0, 0), Eigen::Vector3f(2, 2, 2), materials::adductor_muscle0, pieces);
+    }
+    if(screen(pieces)) return 5;
+
+    // rejected robots are not meshed, valid ones are
+    std::vector<NNRobot> robots(20);
+    for(NNRobot& R : robots) R.Randomize();
+    NNRobot::BatchBuild(robots);
+    for(NNRobot& R : robots) {
+        if(!R.isValid() && (R.springs.size() > 0 || R.cells.size() > 0)) return 6;
+        if(R.isValid() && R.springs.size() == 0) return 7;
+    }
+
+    nnConfig.screen.enabled = false;
+    NNRobot::Configure(nnConfig);
+    if(!screen(air)) return 8;
+
+    return 0;
+}
+
+// Every pair of lattice neighbours (including diagonals) gets exactly one
+// spring, taking bone from an all bone grid. On mixed grids each spring
+// takes the non-air materials of the voxels containing it: the four around
+// an axis edge, the two sharing a face diagonal (the first alone at the
+// grid boundary), or the one a body diagonal crosses.
+int TestVoxelSprings() {
+    const uint side = 5;
+    std::vector<Voxel> voxels(side*side*side);
+    for(uint i = 0; i < voxels.size(); i++) {
+        BasisIdx indices = {(int) (i % side), (int) ((i / side) % side), (int) (i / side / side)};
+        Eigen::Vector3f base(indices.x, indices.y, indices.z);
+        voxels[i] = {i, indices, base + Eigen::Vector3f(0.5f, 0.5f, 0.5f), base, materials::bone};
+    }
+    VoxelRobot R(side, side, side, 1.0f, voxels);
+
+    std::set<std::pair<uint16_t,uint16_t>> expected;
+    for(uint i = 0; i < voxels.size(); i++) {
+        for(uint j = i+1; j < voxels.size(); j++) {
+            Eigen::Vector3f d = voxels[i].base - voxels[j].base;
+            if(d.cwiseAbs().maxCoeff() <= 1.0f) expected.insert({i, j});
+        }
+    }
+
+    std::set<std::pair<uint16_t,uint16_t>> found;
+    for(const Spring& s : R.getSprings()) {
+        found.insert({std::min(s.m0, s.m1), std::max(s.m0, s.m1)});
+        float L = (voxels[s.m0].base - voxels[s.m1].base).norm();
+        if(std::abs(s.rest_length - L) > 1e-5f) return 1;
+        if(s.material != materials::bone) return 2;
+    }
+    if(found.size() != R.getSprings().size()) return 3;
+    if(found != expected) return 4;
+
+    auto nonAir = [](const Material& mat) {
+        return mat.encoding != materials::air.encoding ? mat.encoding : 0x00u;
+    };
+    for(uint trial = 0; trial < 20; trial++) {
+        for(Voxel& v : voxels) v.mat = (rand() % 4 == 0) ? materials::air : materials::random();
+        VoxelRobot M(side, side, side, 1.0f, voxels);
+        const std::vector<Voxel>& mixed = M.getVoxels();
+        auto at = [&](const Eigen::Vector3i& idx) -> const Voxel* {
+            if((idx.array() < 0).any() || (idx.array() >= (int) side).any()) return nullptr;
+            return &mixed[idx.x() + idx.y()*side + idx.z()*side*side];
+        };
+
+        for(const Spring& sp : M.getSprings()) {
+            Eigen::Vector3i a(mixed[sp.m0].indices.x, mixed[sp.m0].indices.y, mixed[sp.m0].indices.z);
+            Eigen::Vector3i b(mixed[sp.m1].indices.x, mixed[sp.m1].indices.y, mixed[sp.m1].indices.z);
+            Eigen::Vector3i lo = a.cwiseMin(b);
+            Eigen::Vector3i d = (a - b).cwiseAbs();
+
+            Material mat;
+            if(d.sum() == 1) {
+                int k = d.x() ? 0 : (d.y() ? 1 : 2);
+                uint32_t encoding = 0x00u;
+                for(int i = 0; i < 4; i++) {
+                    Eigen::Vector3i owner = lo;
+                    owner((k+1)%3) -= i%2;
+                    owner((k+2)%3) -= i/2;
+                    if(at(owner)) encoding |= nonAir(at(owner)->mat);
+                }
+                mat = materials::decode(encoding);
+            } else if(d.sum() == 2) {
+                int k = !d.x() ? 0 : (!d.y() ? 1 : 2);
+                Eigen::Vector3i second = lo;
+                second(k) -= 1;
+                if(!at(second)) mat = at(lo)->mat;
+                else mat = materials::decode(nonAir(at(lo)->mat) | nonAir(at(second)->mat));
+            } else {
+                mat = at(lo)->mat;
+            }
+            if(sp.material != mat) return 5;
+        }
+    }
+
+    return 0;
+}
+
+// Strip keeps the largest face-connected body, the lowest indexed one on ties
+int TestVoxelStrip() {
+    const int side = 6;
+    auto build = [&](const std::vector<BasisIdx>& solid) {
+        std::vector<Voxel> voxels(side*side*side);
+        for(uint i = 0; i < voxels.size(); i++) {
+            BasisIdx indices = {(int) (i % side), (int) ((i / side) % side), (int) (i / side / side)};
+            Eigen::Vector3f base(indices.x, indices.y, indices.z);
+            voxels[i] = {i, indices, base + Eigen::Vector3f(0.5f, 0.5f, 0.5f), base, materials::air};
+        }
+        for(const BasisIdx& b : solid) voxels[b.x + b.y*side + b.z*side*side].mat = materials::bone;
+        VoxelRobot R(side, side, side, 1.0f, voxels);
+
+        std::vector<bool> kept;
+        for(const Voxel& v : R.getVoxels()) kept.push_back(!(v.mat == materials::air));
+        return kept;
+    };
+    auto isKept = [&](const std::vector<bool>& kept, BasisIdx b) {
+        return kept[b.x + b.y*side + b.z*side*side];
+    };
+
+    // larger body wins
+    std::vector<bool> kept = build({{0,0,0}, {1,0,0}, {4,4,4}, {4,4,3}, {4,3,4}});
+    if(isKept(kept, {0,0,0}) || isKept(kept, {1,0,0})) return 1;
+    if(!isKept(kept, {4,4,4}) || !isKept(kept, {4,4,3}) || !isKept(kept, {4,3,4})) return 2;
+
+    // tie goes to the body with the lowest index, edge contact does not connect
+    kept = build({{3,3,3}, {3,3,4}, {0,0,0}, {1,0,0}, {2,1,0}});
+    if(!isKept(kept, {0,0,0}) || !isKept(kept, {1,0,0})) return 3;
+    if(isKept(kept, {3,3,3}) || isKept(kept, {2,1,0})) return 4;
+
+    // nothing to keep
+    kept = build({});
+    for(bool k : kept) if(k) return 5;
+
+    return 0;
+}
+
+// Crossover children inherit every weight row from one of their parents,
+// the two children taking complementary rows, and carry no built body
+int TestNNCrossover() {
+    for(CrossoverType type : {CROSS_INDIVIDUAL, CROSS_CONTIGUOUS}) {
+        Config::NNRobot nnConfig;
+        nnConfig.massCount = 100;
+        nnConfig.crossover_type = type;
+        nnConfig.crossover_distribution = CROSS_DIST_NONE;
+        NNRobot::Configure(nnConfig);
+
+        CandidatePair<NNRobot> parents;
+        parents.first.Randomize();
+        parents.second.Randomize();
+        parents.first.Build();
+        for(int a = 0; a < 3; a++) parents.first.IncrementAge();
+        for(int a = 0; a < 5; a++) parents.second.IncrementAge();
+
+        CandidatePair<NNRobot> children = NNRobot::Crossover(parents);
+        if(children.first.hasPhenotype() || children.second.hasPhenotype()) return 1;
+        if(children.first.age() != 6 || children.second.age() != 6) return 2;
+
+        uint swapped = 0;
+        for(uint l = 0; l < parents.first.getWeights().size(); l++) {
+            for(int r = 0; r < parents.first.getWeights()[l].rows(); r++) {
+                auto p1 = parents.first.getWeights()[l].row(r), p2 = parents.second.getWeights()[l].row(r);
+                auto c1 = children.first.getWeights()[l].row(r), c2 = children.second.getWeights()[l].row(r);
+                if(c1 == p1 && c2 == p2) continue;
+                if(c1 == p2 && c2 == p1) swapped++;
+                else return 3;
+            }
+        }
+        if(swapped == 0) return 4;
+    }
+
+    return 0;
+}
+
+// Circle rasterization assigns the same materials as testing every voxel
+// center against every circle, including centers on a circle's boundary
+int TestVoxelCircles() {
+    for(int trial = 0; trial < 50; trial++) {
+        VoxelRobot R;
+        std::vector<Circle>& circles = R.getCircles();
+        for(uint k = 0; k < circles.size(); k++) {
+            Circle& c = circles[k];
+            if(k % 2 == 0) {
+                c.center = 6.0f * (Eigen::Vector3f::Random() + Eigen::Vector3f::Ones());
+                c.radius = 2.0f * (1.0f + Eigen::Vector2f::Random().x());
+            } else {
+                // on a voxel center with a radius reaching other centers exactly
+                Eigen::Vector3i idx = (Eigen::Vector3f::Random() * 5.0f).cast<int>() + Eigen::Vector3i(6, 6, 6);
+                c.center = idx.cast<float>() + Eigen::Vector3f(0.5f, 0.5f, 0.5f);
+                c.radius = (float) (k % 4);
+            }
+        }
+        R.BuildFromCircles();
+
+        std::vector<Voxel> voxels = R.getVoxels();
+        for(Voxel& v : voxels) {
+            if(v.indices.x == 11 || v.indices.y == 11 || v.indices.z == 11) continue;
+            uint32_t matEncoding = 0x00u;
+            for(const Circle& c : circles) {
+                if((v.center - c.center).norm() < c.radius) matEncoding |= c.mat.encoding;
+            }
+            v.mat = materials::decode(matEncoding);
+        }
+        VoxelRobot reference(12.0f, 12.0f, 12.0f, 1.0f, voxels);
+
+        for(uint i = 0; i < voxels.size(); i++) {
+            if(R.getVoxels()[i].mat != reference.getVoxels()[i].mat) return 1;
+        }
+        if(R.getMasses().size() != reference.getMasses().size()) return 2;
+        if(R.getSprings().size() != reference.getSprings().size()) return 3;
+    }
+
+    return 0;
+}
+
+// Genome clones carry no body, released robots keep their fitness, and a
+// saved phenotype restores the body exactly
+int TestPhenotype() {
+    Config::NNRobot nnConfig;
+    NNRobot::Configure(nnConfig);
+
+    NNRobot R;
+    R.Randomize();
+    R.Build();
+    R.setFitness(3.0f);
+    R.setIsParent(true);
+    if(!R.hasPhenotype()) return 1;
+
+    NNRobot clone = R.CloneGenome();
+    if(clone.hasPhenotype() || clone.getSprings().size() > 0) return 2;
+    if(clone.GenomeHash() != R.GenomeHash()) return 3;
+    if(clone.isParent()) return 4;
+
+    NNRobot::Phenotype saved = R.getPhenotype();
+    R.ReleasePhenotype();
+    if(R.hasPhenotype() || R.getSprings().size() > 0) return 5;
+    if(R.fitness() != 3.0f) return 6;
+
+    R.setPhenotype(saved);
+    if(R.getMasses().size() != saved.body.masses.size()) return 7;
+    if(R.getSprings().size() != saved.body.springs.size()) return 8;
+
+    // crossover children start from their parents' weights, so crossing
+    // a robot with itself gives it back
+    CandidatePair<NNRobot> children = NNRobot::Crossover({R.CloneGenome(), R.CloneGenome()});
+    if(children.first.GenomeHash() != R.GenomeHash()) return 9;
+    if(children.first.hasPhenotype()) return 10;
+
+    return 0;
+}
@@ -0,0 +1,65 @@
+#ifndef __BOUNDED_QUEUE_H__
+#define __BOUNDED_QUEUE_H__
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <vector>
+
+namespace util {
+    // Blocking FIFO shared by producer and consumer threads. Producers
+    // wait while it holds capacity items, so they never run more than
+    // one queue ahead of the consumer. After close() every waiter wakes:
+    // Push refuses new items and PopBatch drains what is left.
+    template<typename T>
+    class BoundedQueue {
+        std::mutex mMutex;
+        std::condition_variable mNotFull, mNotEmpty;
+        std::deque<T> mItems;
+        size_t mCapacity;
+        bool mClosed = false;
+
+    public:
+        explicit BoundedQueue(size_t capacity) : mCapacity(std::max<size_t>(capacity, 1)) {}
+
+        // Returns false, dropping item, once the queue is closed
+        bool Push(T item) {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mNotFull.wait(lock, [this] { return mClosed || mItems.size() < mCapacity; });
+            if(mClosed) return false;
+            mItems.push_back(std::move(item));
+            mNotEmpty.notify_all();
+            return true;
+        }
+
+        // Waits until count items are queued (or the queue is closed) and
+        // appends up to count of them to out. Returns how many were taken.
+        size_t PopBatch(std::vector<T>& out, size_t count) {
+            std::unique_lock<std::mutex> lock(mMutex);
+            count = std::min(count, mCapacity);
+            mNotEmpty.wait(lock, [&] { return mClosed || mItems.size() >= count; });
+            size_t taken = std::min(count, mItems.size());
+            for(size_t i = 0; i < taken; i++) {
+                out.push_back(std::move(mItems.front()));
+                mItems.pop_front();
+            }
+            mNotFull.notify_all();
+            return taken;
+        }
+
+        void Close() {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mClosed = true;
+            mNotFull.notify_all();
+            mNotEmpty.notify_all();
+        }
+
+        size_t size() {
+            std::lock_guard<std::mutex> lock(mMutex);
+            return mItems.size();
+        }
+    };
+}
+
+#endif
@@ -12,6 +12,7 @@ struct Config {
 		std::string in_dir = "";
 		std::string base_dir = "./z_results";
 		std::string out_dir = "./z_results";
+		std::string trace_file = "";	// Chrome trace written to each run directory
 	} io;
 	struct Simulator {
 		bool visual = false;
@@ -36,10 +37,25 @@ struct Config {
 		std::vector<unsigned int> hidden_layer_sizes = {25,25};
 		CrossoverDistribution crossover_distribution = CROSS_DIST_BINOMIAL;
 		CrossoverType crossover_type = CROSS_CONTIGUOUS;
+		AlphaMode alpha_mode = ALPHA_OPTIMAL;
+		float alpha = 4.0f;		// squared alpha radius for ALPHA_FIXED
+		MeshType mesh_type = MESH_ALPHA;
+		float lattice_spacing = 0.0f;	// MESH_LATTICE site spacing, 0 picks it from the mass density
+
+		// Checks on the forward pass output; robots failing them are marked
+		// invalid and skip meshing and simulation
+		struct Screen {
+			bool enabled = false;
+			unsigned int min_masses = 20;	// non-air masses
+			float min_extent = 0.5f;		// smallest side of the non-air bounding box
+			float min_connected = 0.5f;		// fraction of non-air masses in the largest component
+			bool require_muscle = true;
+		} screen;
 	} nnrobot;
 
 	struct Hardware {
 		std::vector<int> cuda_device_ids; // TODO
+		bool perf_counters = false;
 	} hardware;
 };
 
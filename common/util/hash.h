@@ -0,0 +1,39 @@
+#ifndef __HASH_H__
+#define __HASH_H__
+
+#include <cstdint>
+#include <cstring>
+#include <cstddef>
+
+// Content hashing for genome keyed caches. Not cryptographic: a 64 bit
+// multiply-xor over 8 byte words with a splitmix64 finalizer.
+namespace util {
+    inline uint64_t HashMix(uint64_t h) {
+        h ^= h >> 30; h *= 0xbf58476d1ce4e5b9ULL;
+        h ^= h >> 27; h *= 0x94d049bb133111ebULL;
+        h ^= h >> 31;
+        return h;
+    }
+
+    inline uint64_t HashBytes(const void* data, size_t size, uint64_t seed = 0) {
+        const unsigned char* bytes = (const unsigned char*) data;
+        uint64_t h = seed ^ (0x9e3779b97f4a7c15ULL + size);
+        size_t i = 0;
+        for(; i + 8 <= size; i += 8) {
+            uint64_t word;
+            memcpy(&word, bytes + i, 8);
+            h = (h ^ HashMix(word)) * 0x100000001b3ULL;
+        }
+        uint64_t tail = 0;
+        memcpy(&tail, bytes + i, size - i);
+        h = (h ^ HashMix(tail)) * 0x100000001b3ULL;
+        return HashMix(h);
+    }
+
+    template<typename T>
+    inline uint64_t HashValue(const T& value, uint64_t seed = 0) {
+        return HashBytes(&value, sizeof(T), seed);
+    }
+}
+
+#endif
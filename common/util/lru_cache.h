@@ -0,0 +1,97 @@
+#ifndef __LRU_CACHE_H__
+#define __LRU_CACHE_H__
+
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+
+namespace util {
+    // Bounded map that evicts the least recently used entry.
+    // A capacity of 0 disables the cache (lookups miss without counting).
+    // Thread safe; values are copied in and out.
+    template<typename Key, typename Value>
+    class LRUCache {
+        typedef std::list<std::pair<Key, Value>> ItemList;
+
+        size_t mCapacity;
+        ItemList mItems; // most recently used first
+        std::unordered_map<Key, typename ItemList::iterator> mIndex;
+        mutable std::mutex mMutex;
+
+        unsigned long mHits = 0;
+        unsigned long mMisses = 0;
+
+    public:
+        explicit LRUCache(size_t capacity = 0) : mCapacity(capacity) {}
+
+        void setCapacity(size_t capacity) {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mCapacity = capacity;
+            while(mItems.size() > mCapacity) {
+                mIndex.erase(mItems.back().first);
+                mItems.pop_back();
+            }
+        }
+
+        size_t capacity() const { return mCapacity; }
+        bool enabled() const { return mCapacity > 0; }
+
+        size_t size() const {
+            std::lock_guard<std::mutex> lock(mMutex);
+            return mItems.size();
+        }
+
+        // Copies the cached value into value and marks it recently used
+        bool get(const Key& key, Value& value) {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if(mCapacity == 0) return false;
+            auto it = mIndex.find(key);
+            if(it == mIndex.end()) {
+                mMisses++;
+                return false;
+            }
+            mItems.splice(mItems.begin(), mItems, it->second);
+            value = it->second->second;
+            mHits++;
+            return true;
+        }
+
+        void put(const Key& key, Value value) {
+            std::lock_guard<std::mutex> lock(mMutex);
+            if(mCapacity == 0) return;
+            auto it = mIndex.find(key);
+            if(it != mIndex.end()) {
+                it->second->second = std::move(value);
+                mItems.splice(mItems.begin(), mItems, it->second);
+                return;
+            }
+            if(mItems.size() >= mCapacity) {
+                mIndex.erase(mItems.back().first);
+                mItems.pop_back();
+            }
+            mItems.emplace_front(key, std::move(value));
+            mIndex[key] = mItems.begin();
+        }
+
+        void clear() {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mItems.clear();
+            mIndex.clear();
+        }
+
+        unsigned long hits() const { return mHits; }
+        unsigned long misses() const { return mMisses; }
+        float hitRate() const {
+            unsigned long lookups = mHits + mMisses;
+            return lookups > 0 ? (float) mHits / lookups : 0.0f;
+        }
+        void resetStats() {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mHits = 0;
+            mMisses = 0;
+        }
+    };
+}
+
+#endif
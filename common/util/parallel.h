@@ -0,0 +1,37 @@
+#ifndef __PARALLEL_H__
+#define __PARALLEL_H__
+
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+namespace util {
+    // Runs body(begin, end) over [0, count) on up to num_threads workers.
+    // Workers claim grain-sized ranges from a shared counter, so uneven
+    // items (e.g. alpha shapes of different robots) balance themselves.
+    // The calling thread is one of the workers.
+    template<typename Body>
+    void ParallelFor(size_t count, unsigned int num_threads, Body body, size_t grain = 1) {
+        if(count == 0) return;
+        grain = std::max<size_t>(grain, 1);
+        size_t chunks = (count + grain - 1) / grain;
+        num_threads = std::max(1u, (unsigned int) std::min<size_t>(num_threads, chunks));
+
+        std::atomic<size_t> next(0);
+        auto worker = [&]() {
+            for(size_t begin = next.fetch_add(grain); begin < count; begin = next.fetch_add(grain)) {
+                body(begin, std::min(begin + grain, count));
+            }
+        };
+
+        std::vector<std::thread> threads;
+        for(unsigned int i = 1; i < num_threads; i++) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for(std::thread& t : threads) t.join();
+    }
+}
+
+#endif
@@ -0,0 +1,168 @@
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "perf_counters.h"
+
+namespace util {
+namespace perf {
+
+namespace {
+
+const uint64_t kEventConfigs[4] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES
+};
+
+std::atomic<bool> enabled(false);
+std::mutex regions_mutex;
+std::map<std::string, Sample> regions;
+
+// One counter group per thread, opened on first use and left running.
+// Scopes take differences of free running counters so they can nest.
+struct ThreadCounters {
+    int fds[4] = {-1, -1, -1, -1};
+    bool opened = false;
+    bool available = false;
+
+    void Open() {
+        opened = true;
+        for(int i = 0; i < 4; i++) {
+            struct perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.size = sizeof(attr);
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = kEventConfigs[i];
+            attr.disabled = (i == 0);
+            attr.exclude_kernel = 1;
+            attr.exclude_hv = 1;
+            attr.read_format = PERF_FORMAT_GROUP;
+
+            int group = (i == 0) ? -1 : fds[0];
+            fds[i] = syscall(__NR_perf_event_open, &attr, 0, -1, group, 0);
+            if(fds[i] < 0) {
+                Close();
+                return;
+            }
+        }
+        ioctl(fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+        available = true;
+    }
+
+    void Close() {
+        for(int i = 0; i < 4; i++) {
+            if(fds[i] >= 0) close(fds[i]);
+            fds[i] = -1;
+        }
+        available = false;
+    }
+
+    bool Read(uint64_t values[4]) {
+        if(!opened) Open();
+        if(!available) return false;
+
+        uint64_t buf[5];
+        if(read(fds[0], buf, sizeof(buf)) != sizeof(buf) || buf[0] != 4) return false;
+        for(int i = 0; i < 4; i++) values[i] = buf[i+1];
+        return true;
+    }
+
+    ~ThreadCounters() { Close(); }
+};
+
+thread_local ThreadCounters thread_counters;
+
+double Now() {
+    return std::chrono::duration<double>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+}
+
+void Enable(bool e) { enabled = e; }
+
+bool Enabled() { return enabled; }
+
+bool Available() {
+    uint64_t values[4];
+    return thread_counters.Read(values);
+}
+
+Scope::Scope(const char* region, uint64_t springs) :
+    mRegion(region), mSprings(springs), mActive(enabled)
+{
+    if(!mActive) return;
+    if(!thread_counters.Read(mStart)) {
+        memset(mStart, 0, sizeof(mStart));
+    }
+    mStartTime = Now();
+}
+
+Scope::~Scope() {
+    if(!mActive) return;
+    double end_time = Now();
+
+    Sample sample;
+    sample.seconds = end_time - mStartTime;
+    sample.springs = mSprings;
+    sample.calls = 1;
+
+    uint64_t end[4];
+    if(thread_counters.Read(end)) {
+        sample.counters = true;
+        sample.cycles       = end[0] - mStart[0];
+        sample.instructions = end[1] - mStart[1];
+        sample.llcMisses    = end[2] - mStart[2];
+        sample.branchMisses = end[3] - mStart[3];
+    }
+    Record(mRegion, sample);
+}
+
+void Record(const std::string& region, const Sample& sample) {
+    std::lock_guard<std::mutex> lock(regions_mutex);
+    Sample& total = regions[region];
+    total.seconds      += sample.seconds;
+    total.cycles       += sample.cycles;
+    total.instructions += sample.instructions;
+    total.llcMisses    += sample.llcMisses;
+    total.branchMisses += sample.branchMisses;
+    total.springs      += sample.springs;
+    total.calls        += sample.calls;
+    total.counters     = total.counters || sample.counters;
+}
+
+std::string Report() {
+    std::lock_guard<std::mutex> lock(regions_mutex);
+    std::string report;
+    char buf[256];
+    for(const auto& r : regions) {
+        const Sample& s = r.second;
+        if(!s.counters) {
+            snprintf(buf, sizeof(buf), "%-20s %8lu calls %10.4fs (timing only)\n",
+                r.first.c_str(), s.calls, s.seconds);
+        } else {
+            double springs = s.springs > 0 ? (double) s.springs : 1.0;
+            snprintf(buf, sizeof(buf), "%-20s %8lu calls %10.4fs IPC %5.2f  LLC miss/spring %8.3f  branch miss/spring %8.3f\n",
+                r.first.c_str(), s.calls, s.seconds, s.ipc(),
+                s.llcMisses / springs, s.branchMisses / springs);
+        }
+        report += buf;
+    }
+    return report;
+}
+
+void Reset() {
+    std::lock_guard<std::mutex> lock(regions_mutex);
+    regions.clear();
+}
+
+}
+}
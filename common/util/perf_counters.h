@@ -0,0 +1,58 @@
+#ifndef __PERF_COUNTERS_H__
+#define __PERF_COUNTERS_H__
+
+#include <cstdint>
+#include <string>
+
+namespace util {
+namespace perf {
+    // Hardware counter totals for one instrumented region.
+    // counters is false when only wall time could be measured.
+    struct Sample {
+        double seconds = 0;
+        uint64_t cycles = 0;
+        uint64_t instructions = 0;
+        uint64_t llcMisses = 0;
+        uint64_t branchMisses = 0;
+        uint64_t springs = 0;
+        unsigned long calls = 0;
+        bool counters = false;
+
+        double ipc() const { return cycles > 0 ? (double) instructions / cycles : 0.0; }
+    };
+
+    // Collection is off unless enabled (PERF_COUNTERS config key)
+    void Enable(bool enabled);
+    bool Enabled();
+
+    // Whether perf_event_open succeeded on the calling thread
+    bool Available();
+
+    // Measures the calling thread between construction and destruction
+    // and adds the result to the named region. Scopes may nest.
+    class Scope {
+        const char* mRegion;
+        uint64_t mSprings;
+        bool mActive;
+        double mStartTime;
+        uint64_t mStart[4];
+    public:
+        Scope(const char* region, uint64_t springs = 0);
+        ~Scope();
+        void setSprings(uint64_t springs) { mSprings = springs; }
+    };
+
+    void Record(const std::string& region, const Sample& sample);
+
+    // One line per region: time, IPC and misses per spring
+    std::string Report();
+    void Reset();
+}
+}
+
+#define PERF_SCOPE_CONCAT_(a,b) a##b
+#define PERF_SCOPE_CONCAT(a,b) PERF_SCOPE_CONCAT_(a,b)
+#define PERF_SCOPE(region, springs) \
+    util::perf::Scope PERF_SCOPE_CONCAT(_perf_scope_, __LINE__)(region, springs)
+
+#endif
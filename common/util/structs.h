@@ -21,4 +21,15 @@ enum CrossoverType {
 	CROSS_CONTIGUOUS = 1
 };
 
+enum AlphaMode {
+	ALPHA_OPTIMAL = 0,	// search the spectrum for the smallest solid alpha per robot
+	ALPHA_FIXED = 1,	// use the configured alpha
+	ALPHA_CACHED = 2	// search once, reuse that alpha for every later robot
+};
+
+enum MeshType {
+	MESH_ALPHA = 0,		// CGAL alpha shape of the mass cloud
+	MESH_LATTICE = 1	// masses snapped to a BCC lattice
+};
+
 #endif
\ No newline at end of file
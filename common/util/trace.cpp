@@ -0,0 +1,112 @@
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
+#include "trace.h"
+#include "util.h"
+
+namespace util {
+namespace trace {
+
+namespace {
+
+struct Event {
+    const char* name;
+    const char* category;
+    int64_t begin;
+    int64_t duration;
+};
+
+struct ThreadBuffer {
+    int tid;
+    std::atomic<bool> inUse;
+    std::vector<Event> events;
+};
+
+std::atomic<bool> enabled(false);
+const auto epoch = std::chrono::steady_clock::now();
+
+// Buffers are only created or claimed when a thread records its first
+// span. Buffers of exited threads are reused by new threads, so the
+// short lived BatchBuild workers map onto a bounded set of lanes.
+std::mutex buffers_mutex;
+std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+
+ThreadBuffer* AcquireBuffer() {
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    for(auto& b : buffers) {
+        bool expected = false;
+        if(b->inUse.compare_exchange_strong(expected, true)) return b.get();
+    }
+    buffers.emplace_back(new ThreadBuffer());
+    ThreadBuffer* b = buffers.back().get();
+    b->tid = buffers.size();
+    b->inUse = true;
+    b->events.reserve(1024);
+    return b;
+}
+
+struct BufferHandle {
+    ThreadBuffer* buffer = nullptr;
+    ~BufferHandle() { if(buffer) buffer->inUse = false; }
+};
+
+thread_local BufferHandle thread_buffer;
+
+}
+
+void Enable(bool e) { enabled = e; }
+
+bool Enabled() { return enabled; }
+
+int64_t Now() {
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - epoch).count();
+}
+
+void Record(const char* name, const char* category, int64_t begin, int64_t end) {
+    if(thread_buffer.buffer == nullptr) thread_buffer.buffer = AcquireBuffer();
+    thread_buffer.buffer->events.push_back({name, category, begin, end - begin});
+}
+
+Scope::Scope(const char* name, const char* category) :
+    mName(name), mCategory(category), mBegin(enabled ? Now() : -1) {}
+
+Scope::~Scope() {
+    if(mBegin < 0) return;
+    Record(mName, mCategory, mBegin, Now());
+}
+
+int WriteChromeTrace(const std::string& filename, const std::string& directory) {
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    std::ostringstream os;
+    bool first = true;
+
+    os << "{\"traceEvents\":[\n";
+    for(const auto& b : buffers) {
+        os << (first ? "" : ",\n")
+           << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << b->tid
+           << ",\"args\":{\"name\":\"" << (b->tid == 1 ? "main" : "worker " + std::to_string(b->tid)) << "\"}}";
+        first = false;
+        for(const Event& e : b->events) {
+            os << ",\n{\"name\":\"" << e.name << "\",\"cat\":\"" << e.category
+               << "\",\"ph\":\"X\",\"ts\":" << e.begin << ",\"dur\":" << e.duration
+               << ",\"pid\":1,\"tid\":" << b->tid << "}";
+        }
+    }
+    os << "\n],\"displayTimeUnit\":\"ms\"}\n";
+
+    return util::WriteCSV(filename, directory, os.str());
+}
+
+void Clear() {
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    for(auto& b : buffers) {
+        b->events.clear();
+    }
+}
+
+}
+}
@@ -0,0 +1,45 @@
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+#include <cstdint>
+#include <string>
+
+// Span tracing exported as Chrome trace JSON (chrome://tracing, Perfetto).
+// Each thread appends to its own buffer, so recording a span takes no lock.
+namespace util {
+namespace trace {
+    // Recording is off unless enabled (TRACE_FILE config key)
+    void Enable(bool enabled);
+    bool Enabled();
+
+    // Microseconds since the trace epoch
+    int64_t Now();
+
+    // Appends a complete span to the calling thread's buffer
+    void Record(const char* name, const char* category, int64_t begin, int64_t end);
+
+    // Records the lifetime of the scope as a span.
+    // name and category must outlive the trace (string literals).
+    class Scope {
+        const char* mName;
+        const char* mCategory;
+        int64_t mBegin;
+    public:
+        Scope(const char* name, const char* category = "optimize");
+        ~Scope();
+    };
+
+    // Writes all buffered spans. Call while no traced threads are running.
+    int WriteChromeTrace(const std::string& filename, const std::string& directory);
+
+    // Drops all buffered spans
+    void Clear();
+}
+}
+
+#define TRACE_SCOPE_CONCAT_(a,b) a##b
+#define TRACE_SCOPE_CONCAT(a,b) TRACE_SCOPE_CONCAT_(a,b)
+#define TRACE_SCOPE(...) \
+    util::trace::Scope TRACE_SCOPE_CONCAT(_trace_scope_, __LINE__)(__VA_ARGS__)
+
+#endif
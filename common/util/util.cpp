@@ -5,6 +5,7 @@
 #include <chrono>
 #include <ctime>
 #include <sys/stat.h>
+#include <sys/resource.h>
 #include <cstring>
 #include <memory>
 #include <unordered_map>
@@ -12,6 +13,12 @@
 
 namespace util {
 
+size_t PeakRSS() {
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+    return (size_t) usage.ru_maxrss * 1024; // kilobytes on Linux
+}
+
 void RemoveOldFiles(const std::string& dir) {
     DIR* directory = opendir(dir.data());
     if (directory == nullptr) {
@@ -149,6 +156,10 @@ Config common::ReadConfigFile(const std::string& filename) {
         config.io.base_dir = config_map["BASE_DIR"];
     }
 
+    if(config_map.find("TRACE_FILE") != config_map.end()) {
+        config.io.trace_file = config_map["TRACE_FILE"];
+    }
+
     if(config_map.find("TIME_STEP") != config_map.end()) {
         config.simulator.time_step = stof(config_map["TIME_STEP"]);
     }
@@ -208,6 +219,56 @@ Config common::ReadConfigFile(const std::string& filename) {
         }
     }
 
+    if(config_map.find("ALPHA_MODE") != config_map.end()) {
+        if(config_map["ALPHA_MODE"] == "optimal") {
+            config.nnrobot.alpha_mode = ALPHA_OPTIMAL;
+        } else if(config_map["ALPHA_MODE"] == "fixed") {
+            config.nnrobot.alpha_mode = ALPHA_FIXED;
+        } else if(config_map["ALPHA_MODE"] == "cached") {
+            config.nnrobot.alpha_mode = ALPHA_CACHED;
+        } else {
+            std::cerr << "Alpha mode " << config_map["ALPHA_MODE"] << " not supported" << std::endl;
+        }
+    }
+
+    if(config_map.find("ALPHA") != config_map.end()) {
+        config.nnrobot.alpha = stof(config_map["ALPHA"]);
+    }
+
+    if(config_map.find("MESH_TYPE") != config_map.end()) {
+        if(config_map["MESH_TYPE"] == "alpha") {
+            config.nnrobot.mesh_type = MESH_ALPHA;
+        } else if(config_map["MESH_TYPE"] == "lattice") {
+            config.nnrobot.mesh_type = MESH_LATTICE;
+        } else {
+            std::cerr << "Mesh type " << config_map["MESH_TYPE"] << " not supported" << std::endl;
+        }
+    }
+
+    if(config_map.find("LATTICE_SPACING") != config_map.end()) {
+        config.nnrobot.lattice_spacing = stof(config_map["LATTICE_SPACING"]);
+    }
+
+    if(config_map.find("SCREEN") != config_map.end()) {
+        config.nnrobot.screen.enabled = config_map["SCREEN"] == "true" || config_map["SCREEN"] == "1";
+    }
+
+    if(config_map.find("SCREEN_MIN_MASSES") != config_map.end()) {
+        config.nnrobot.screen.min_masses = stoi(config_map["SCREEN_MIN_MASSES"]);
+    }
+
+    if(config_map.find("SCREEN_MIN_EXTENT") != config_map.end()) {
+        config.nnrobot.screen.min_extent = stof(config_map["SCREEN_MIN_EXTENT"]);
+    }
+
+    if(config_map.find("SCREEN_MIN_CONNECTED") != config_map.end()) {
+        config.nnrobot.screen.min_connected = stof(config_map["SCREEN_MIN_CONNECTED"]);
+    }
+
+    if(config_map.find("SCREEN_REQUIRE_MUSCLE") != config_map.end()) {
+        config.nnrobot.screen.require_muscle = config_map["SCREEN_REQUIRE_MUSCLE"] == "true" || config_map["SCREEN_REQUIRE_MUSCLE"] == "1";
+    }
+
     if(config_map.find("CUDA_VISIBLE_DEVICES") != config_map.end()) {
         config.hardware.cuda_device_ids.clear();
         
@@ -219,6 +280,10 @@ Config common::ReadConfigFile(const std::string& filename) {
         }
     }
 
+    if(config_map.find("PERF_COUNTERS") != config_map.end()) {
+        config.hardware.perf_counters = config_map["PERF_COUNTERS"] == "true" || config_map["PERF_COUNTERS"] == "1";
+    }
+
     return config;
 }
 
@@ -18,6 +18,9 @@ namespace util {
 
     void RemoveOldFiles(const std::string& dir);
 
+    // Peak resident set size of the process so far, in bytes
+    size_t PeakRSS();
+
     RobotType ReadRobotType(const std::string& filename);
 
     namespace common {
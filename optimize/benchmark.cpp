@@ -1,39 +1,45 @@
 #include "Simulator.h"
 #include "VoxelRobot.h"
 #include "NNRobot.h"
+#include "optimizer.h"
 #include "util.h"
+#include "benchmark.h"
+#include "perf_counters.h"
 
 #include <thread>
 #include <iostream>
 #include <sys/stat.h>
 #include <chrono>
+#include <algorithm>
+#include <limits>
+
+#define DEFAULT_VOXEL_SIZE 12
+#define DEFAULT_NN_SIZE 1708
+#define BENCHMARK_SEED 2383
+
+std::vector<benchmark::Result> VoxelBenchmark(const benchmark::Options& opt, bool trackStresses);
+std::vector<benchmark::Result> DevoBenchmark(const benchmark::Options& opt);
+std::vector<benchmark::Result> NNBenchmark(const benchmark::Options& opt);
+std::vector<benchmark::Result> NNBuildBenchmark(const benchmark::Options& opt);
+std::vector<benchmark::Result> VoxelBuildBenchmark(const benchmark::Options& opt);
+std::vector<benchmark::Result> ScalingBenchmark(const benchmark::Options& opt);
+std::vector<benchmark::Result> GenerationBenchmark(const benchmark::Options& opt);
+void handle_commandline_args(int argc, char** argv);
 
-// #define MAX_TIME 5
-// #define POP_SIZE 1
-
-// TODO: Use config file
-
-#define MAX_TIME 0.5
-#define MAX_SPRINGS 1e11
-#define MAX_ROBOTS 512
-#define INIT_POP_SIZE 1
-
-void VoxelBenchmark();
-void StressBenchmark();
-void DevoBenchmark();
-void NNBenchmark();
-void NNBuildBenchmark();
 Simulator sim;
+Config config;
 
-using namespace std::chrono_literals;
+std::string scenario = "voxel";
+benchmark::Options options;
 
 std::string out_dir;
 
 int main(int argc, char** argv)
 {
-	// sim.Initialize(solution.masses.size(),solution.springs.size(), POP_SIZE);
-	uint seed = std::chrono::system_clock::now().time_since_epoch().count();
-    srand(seed);
+	// Fixed seed so that runs are comparable against a stored baseline
+	srand(BENCHMARK_SEED);
+
+	handle_commandline_args(argc, argv);
 
 	// Get current date and time
 	auto now = std::chrono::system_clock::now();
@@ -48,284 +54,461 @@ int main(int argc, char** argv)
 	out_dir = std::string("../z_results/benchmarks/") + std::string(time_str);
 	util::MakeDirectory(out_dir);
 
-	if(argc > 1) {
-		if(std::string(argv[1]) == std::string("voxel"))
-			VoxelBenchmark();
-		else if(std::string(argv[1]) == std::string("nn"))
-			NNBenchmark();
-		else if(std::string(argv[1]) == std::string("build"))
-			NNBuildBenchmark();
-		else if(std::string(argv[1]) == std::string("stress"))
-			StressBenchmark();
-		else if(std::string(argv[1]) == std::string("devo"))
-			DevoBenchmark();
-		else
-			VoxelBenchmark();
+	sim.Initialize(config.simulator);
+
+	std::vector<benchmark::Result> results;
+	if(scenario == "nn")
+		results = NNBenchmark(options);
+	else if(scenario == "build")
+		results = NNBuildBenchmark(options);
+	else if(scenario == "voxel_build")
+		results = VoxelBuildBenchmark(options);
+	else if(scenario == "stress")
+		results = VoxelBenchmark(options, true);
+	else if(scenario == "devo")
+		results = DevoBenchmark(options);
+	else if(scenario == "scaling")
+		results = ScalingBenchmark(options);
+	else if(scenario == "generation")
+		results = GenerationBenchmark(options);
+	else
+		results = VoxelBenchmark(options, false);
+
+	std::string json = benchmark::ToJSON(scenario, options, results);
+	if(options.json_file == "") {
+		util::WriteCSV(scenario + "_benchmark.json", out_dir, json);
+		printf("WROTE %s/%s_benchmark.json\n", out_dir.c_str(), scenario.c_str());
 	} else {
-		VoxelBenchmark();
+		std::ofstream outfile(options.json_file);
+		outfile << json;
+		printf("WROTE %s\n", options.json_file.c_str());
 	}
-	
-	return 0;
-}
-
-void VoxelBenchmark() {
-	printf("BENCHMARKING VOXELS\n");
-	VoxelRobot R;
-
-	uint pop_size = INIT_POP_SIZE;
 
-	ulong num_springs = R.getSprings().size() * (MAX_TIME / sim.getDeltaT());
-
-	FILE* pFile = fopen((out_dir + "/voxel_benchmark.csv").c_str(),"w");
-
-	float execute_time;
-
-	fprintf(pFile,"springs simulated, execute time, springs per second\n");
-
-	while(num_springs < MAX_SPRINGS) {
-		std::vector<Element> robots;
-		for(uint i = 0; i < pop_size; i++) {
-			robots.push_back(R);
-		}
-
-		// printf("POPULATION SIZE:\t%u ROBOTS\n", pop_size);
-		
-		sim.SetElements(robots);
-
-		printf("STARTED\n");
-		auto start = std::chrono::high_resolution_clock::now();
-		
-		sim.Simulate(MAX_TIME);
-		auto end = std::chrono::high_resolution_clock::now();
-		printf("FINISHED\n\n");
-
-		execute_time = std::chrono::duration<float>(end - start).count();
+	if(util::perf::Enabled()) {
+		printf("----PERF COUNTERS%s----\n", util::perf::Available() ? "" : " UNAVAILABLE, TIMING ONLY");
+		printf("%s", util::perf::Report().c_str());
+	}
 
-		num_springs = 0;
-		for(auto& R : robots) {
-			num_springs += R.springs.size();
-		}
-		num_springs = num_springs * (MAX_TIME / sim.getDeltaT());
-		float springs_per_sec = num_springs / execute_time;
+	if(options.baseline_file != "") {
+		int regressions = benchmark::CompareToBaseline(results, options);
+		if(regressions > 0) return 1;
+	}
 
-		fprintf(pFile,"%lu,%f,%f\n", num_springs,execute_time,springs_per_sec);
-		printf("%u ROBOTS (%.2e SPRINGS) IN %f SECONDS\n", pop_size, (float) num_springs, execute_time);
-		printf("%.2e SPRINGS PER SECOND\n", (float) springs_per_sec);
-		printf("--------------------------\n");
+	return 0;
+}
 
-		pop_size *= 2;
+// Builds a solid cube of bone voxels with the given side length
+VoxelRobot MakeVoxelRobot(uint side) {
+	std::vector<Voxel> voxels(side*side*side);
+	float resolution = 1.0f;
+	Eigen::Vector3f center_correction = (1.0f/resolution)*Eigen::Vector3f(0.5f,0.5f,0.5f);
+	for(uint i = 0; i < voxels.size(); i++) {
+		BasisIdx indices = {(int) (i % side), (int) ((i / side) % side), (int) (i / side / side)};
+		Eigen::Vector3f base(indices.x, indices.y, indices.z);
+		Eigen::Vector3f center = base + center_correction;
+		if((uint) indices.x == side-1 || (uint) indices.y == side-1 || (uint) indices.z == side-1)
+			voxels[i] = {i, indices, center, base, materials::air};
+		else
+			voxels[i] = {i, indices, center, base, materials::bone};
 	}
-	fclose(pFile);
+	return VoxelRobot(side, side, side, resolution, voxels);
 }
 
-void StressBenchmark() {
-	printf("BENCHMARKING VOXEL STRESSES\n");
-	VoxelRobot R;
+std::vector<NNRobot> MakeNNRobots(uint batch, uint size) {
+	config.nnrobot.massCount = size;
+	NNRobot::Configure(config.nnrobot);
 
-	uint pop_size = INIT_POP_SIZE;
-
-	ulong num_springs = R.getSprings().size() * (MAX_TIME / sim.getDeltaT());
-
-	FILE* pFile = fopen((out_dir + "/stress_benchmark.csv").c_str(),"w");
-
-	float execute_time;
+	std::vector<NNRobot> robots(batch);
+	for(NNRobot& R : robots) {
+		R.Randomize();
+	}
+	return robots;
+}
 
-	fprintf(pFile,"springs simulated, execute time, springs per second\n");
+benchmark::Result SimulateCase(const std::string& name, const std::vector<Element>& robots,
+								uint size, const benchmark::Options& opt, bool trackStresses) {
+	benchmark::Result result;
+	result.name = name;
+	result.batch = robots.size();
+	result.size = size;
+	result.steps = opt.steps;
+	result.masses = robots[0].masses.size();
+	for(const Element& e : robots) {
+		result.springs += e.springs.size();
+	}
+	result.work = (double) result.springs * opt.steps;
+	result.unit = "spring_steps/s";
 
-	while(num_springs < MAX_SPRINGS) {
-		std::vector<Element> robots;
-		for(uint i = 0; i < pop_size; i++) {
-			robots.push_back(R);
-		}
+	float sim_time = opt.steps * sim.getDeltaT();
+	benchmark::Run(result, opt,
+		[&]() { sim.Reset(); sim.SetElements(robots); },
+		[&]() { sim.Simulate(sim_time, trackStresses); });
 
-		// printf("POPULATION SIZE:\t%u ROBOTS\n", pop_size);
-		
-		sim.SetElements(robots);
+	benchmark::Print(result);
+	return result;
+}
 
-		printf("STARTED\n");
-		auto start = std::chrono::high_resolution_clock::now();
-		
-		sim.Simulate(MAX_TIME, true);
-		auto end = std::chrono::high_resolution_clock::now();
-		printf("FINISHED\n\n");
+std::vector<benchmark::Result> VoxelBenchmark(const benchmark::Options& opt, bool trackStresses) {
+	printf("BENCHMARKING VOXEL%s\n", trackStresses ? " STRESSES" : "S");
+	std::vector<benchmark::Result> results;
 
-		execute_time = std::chrono::duration<float>(end - start).count();
+	std::vector<uint> sizes = opt.robot_sizes;
+	if(sizes.empty()) sizes = {DEFAULT_VOXEL_SIZE};
 
-		num_springs = 0;
-		for(auto& R : robots) {
-			num_springs += R.springs.size();
+	for(uint size : sizes) {
+		VoxelRobot R = MakeVoxelRobot(size);
+		for(uint batch : opt.batch_sizes) {
+			std::vector<Element> robots(batch, R);
+			results.push_back(SimulateCase(trackStresses ? "stress" : "voxel", robots, size, opt, trackStresses));
 		}
-		num_springs = num_springs * (MAX_TIME / sim.getDeltaT());
-		float springs_per_sec = num_springs / execute_time;
-
-		fprintf(pFile,"%lu,%f,%f\n", num_springs,execute_time,springs_per_sec);
-		printf("%u ROBOTS (%.2e SPRINGS) IN %f SECONDS\n", pop_size, (float) num_springs, execute_time);
-		printf("%.2e SPRINGS PER SECOND\n", (float) springs_per_sec);
-		printf("--------------------------\n");
-
-		pop_size *= 2;
 	}
-	fclose(pFile);
+	return results;
 }
 
-void DevoBenchmark() {
+std::vector<benchmark::Result> DevoBenchmark(const benchmark::Options& opt) {
 	printf("BENCHMARKING VOXEL DEVOS\n");
-	VoxelRobot R;
-
-	uint pop_size = INIT_POP_SIZE;
-
-	Config::Simulator simConfig;
-	ulong num_springs = simConfig.replaced_springs_per_element;
-	sim.Initialize(simConfig);
-
-	FILE* pFile = fopen((out_dir + "/devo_benchmark.csv").c_str(),"w");
-
-	float execute_time;
-
-	fprintf(pFile,"springs replaced, execute time, springs per second\n");
-
-	while(pop_size < MAX_ROBOTS*20) {
-		std::vector<Element> robots;
-		for(uint i = 0; i < pop_size; i++) {
-			robots.push_back(R);
+	std::vector<benchmark::Result> results;
+
+	std::vector<uint> sizes = opt.robot_sizes;
+	if(sizes.empty()) sizes = {DEFAULT_VOXEL_SIZE};
+
+	for(uint size : sizes) {
+		VoxelRobot R = MakeVoxelRobot(size);
+		for(uint batch : opt.batch_sizes) {
+			std::vector<Element> robots(batch, R);
+
+			benchmark::Result result;
+			result.name = "devo";
+			result.batch = batch;
+			result.size = size;
+			result.masses = R.getMasses().size();
+			result.springs = R.getSprings().size() * batch;
+			result.work = (double) config.simulator.replaced_springs_per_element * batch;
+			result.unit = "springs_replaced/s";
+
+			benchmark::Run(result, opt,
+				[&]() { sim.Reset(); sim.SetElements(robots); },
+				[&]() { sim.Devo(); });
+
+			benchmark::Print(result);
+			results.push_back(result);
 		}
-		printf("POPULATION SIZE:\t%u ROBOTS\n", pop_size);
-		
-
-		sim.SetElements(robots);
-
-		printf("STARTED\n");
-		auto start = std::chrono::high_resolution_clock::now();
-		
-		sim.Devo();
-		auto end = std::chrono::high_resolution_clock::now();
-		printf("FINISHED\n\n");
-
-		execute_time = std::chrono::duration<float>(end - start).count();
-
-		num_springs = simConfig.replaced_springs_per_element * pop_size;
-		float springs_per_sec = num_springs / execute_time;
-
-		fprintf(pFile,"%lu,%f,%f\n", num_springs, execute_time, springs_per_sec);
-		printf("%.2e SPRINGS REPLACED IN %f SECONDS\n", (float) num_springs, execute_time);
-		printf("%.2e SPRINGS PER SECOND\n", (float) springs_per_sec);
-		printf("--------------------------\n");
-
-		pop_size *= 2;
 	}
-	fclose(pFile);
+	return results;
 }
 
-void NNBuildBenchmark() {
+std::vector<benchmark::Result> NNBuildBenchmark(const benchmark::Options& opt) {
 	printf("BENCHMARKING NN BUILD\n");
+	std::vector<benchmark::Result> results;
+
+	std::vector<uint> sizes = opt.robot_sizes;
+	if(sizes.empty()) sizes = {DEFAULT_NN_SIZE};
+
+	for(uint size : sizes) {
+		for(uint batch : opt.batch_sizes) {
+			std::vector<NNRobot> proto = MakeNNRobots(batch, size);
+			std::vector<NNRobot> robots;
+
+			benchmark::Result result;
+			result.name = "build";
+			if(config.nnrobot.mesh_type == MESH_LATTICE) result.name += "_lattice";
+			else if(config.nnrobot.alpha_mode == ALPHA_FIXED) result.name += "_fixed";
+			else if(config.nnrobot.alpha_mode == ALPHA_CACHED) result.name += "_cached";
+			result.batch = batch;
+			result.size = size;
+			result.masses = size;
+			result.work = batch;
+			result.unit = "robots/s";
+
+			benchmark::Run(result, opt,
+				[&]() { robots = proto; },
+				[&]() { NNRobot::BatchBuild(robots); });
+
+			for(const NNRobot& R : robots) {
+				result.springs += R.getSprings().size();
+			}
+
+			// BatchBuild default: all but one hardware thread
+			uint threads = std::max(1u, std::thread::hardware_concurrency() - 1);
+			threads = std::min(threads, batch);
+			result.threads = threads;
+
+			benchmark::Print(result);
+			printf("\t%.3e robots/s per core (%u threads)\n", result.throughput / threads, threads);
+			results.push_back(result);
+		}
+	}
+	return results;
+}
 
-	NNRobot R;
-
-	uint pop_size = INIT_POP_SIZE;
-
-	FILE* pFile = fopen((out_dir + "/nnbuild_benchamrk.csv").c_str(),"w");
+std::vector<benchmark::Result> VoxelBuildBenchmark(const benchmark::Options& opt) {
+	printf("BENCHMARKING VOXEL BUILD\n");
+	std::vector<benchmark::Result> results;
 
-	float execute_time;
+	std::vector<uint> sizes = opt.robot_sizes;
+	if(sizes.empty()) sizes = {DEFAULT_VOXEL_SIZE};
 
-	// fprintf(pFile,"springs simulated, springs per iteration, execute time\n");
-	fprintf(pFile,"springs processed, execute time, springs per second\n");
+	for(uint size : sizes) {
+		VoxelRobot R = MakeVoxelRobot(size);
+		for(uint batch : opt.batch_sizes) {
+			std::vector<VoxelRobot> robots(batch, R);
 
-	ulong num_springs;
-	while(pop_size <= MAX_ROBOTS) {
-		std::vector<NNRobot> robots;
+			benchmark::Result result;
+			result.name = "voxel_build";
+			result.batch = batch;
+			result.size = size;
+			result.masses = R.getMasses().size();
+			result.springs = R.getSprings().size() * batch;
+			result.work = batch;
+			result.unit = "robots/s";
 
-		auto start = std::chrono::high_resolution_clock::now();
-		for(uint i = 0; i < pop_size; i++) {
-			NNRobot R;
-			R.Randomize();
-			robots.push_back(R);
-		}
-		NNRobot::BatchBuild(robots);
-		auto end = std::chrono::high_resolution_clock::now();
+			benchmark::Run(result, opt,
+				[]() {},
+				[&]() { VoxelRobot::BatchBuild(robots); });
 
-		execute_time = std::chrono::duration<float>(end - start).count();
+			// BatchBuild default: all hardware threads
+			result.threads = std::min(std::max(1u, std::thread::hardware_concurrency()), batch);
 
-		num_springs = 0;
-		for(auto& R : robots) {
-			num_springs += R.getSprings().size();
+			benchmark::Print(result);
+			results.push_back(result);
 		}
-		float springs_per_sec = num_springs / execute_time;
-
-		fprintf(pFile,"%lu,%f,%f\n", num_springs,execute_time,springs_per_sec);
-		printf("BUILT %u ROBOTS IN %f SECONDS\n", pop_size, execute_time);
-		printf("%.2e SPRINGS PER SECONDS\n", springs_per_sec);
-		printf("--------------------------\n");
-
-		pop_size *= 2;
 	}
-	fclose(pFile);
+	return results;
 }
 
-void NNBenchmark() {
+std::vector<benchmark::Result> NNBenchmark(const benchmark::Options& opt) {
 	printf("BENCHMARKING NN\n");
+	std::vector<benchmark::Result> results;
 
-	NNRobot R;
-	ulong num_springs;
-	
-	uint pop_size = INIT_POP_SIZE;
+	std::vector<uint> sizes = opt.robot_sizes;
+	if(sizes.empty()) sizes = {DEFAULT_NN_SIZE};
 
-	FILE* pFile = fopen((out_dir + "/nn_benchamrk.csv").c_str(),"w");
+	for(uint size : sizes) {
+		for(uint batch : opt.batch_sizes) {
+			std::vector<NNRobot> robots = MakeNNRobots(batch, size);
+			NNRobot::BatchBuild(robots);
 
-	float execute_time;
+			std::vector<Element> robot_elements;
+			for(auto& R : robots) {
+				robot_elements.push_back(R);
+			}
 
-	fprintf(pFile,"springs simulated, springs per iteration, execute time, springs per second\n");
-
-	do {
-		std::vector<NNRobot> robots;
-		std::vector<Element> robot_elements;
-
-		auto start = std::chrono::high_resolution_clock::now();
-		for(uint i = 0; i < pop_size; i++) {
-			NNRobot R;
-			R.Randomize();
-			robots.push_back(R);
+			results.push_back(SimulateCase("nn", robot_elements, size, opt, false));
 		}
-		NNRobot::BatchBuild(robots);
-		auto end = std::chrono::high_resolution_clock::now();
+	}
+	return results;
+}
 
-		execute_time = std::chrono::duration<float>(end - start).count();
-		printf("BUILT %u ROBOTS IN %f SECONDS\n", pop_size, execute_time);
+// Times one build + simulate pass of unbuilt robots with the given thread count
+template<typename T>
+benchmark::Result ScalingCase(const std::vector<T>& proto, uint size, uint threads, const benchmark::Options& opt) {
+	benchmark::Result result;
+	result.name = "scaling_" + opt.robot;
+	result.batch = proto.size();
+	result.size = size;
+	result.threads = threads;
+	result.steps = opt.steps;
+	result.unit = "spring_steps/s";
+
+	float sim_time = opt.steps * sim.getDeltaT();
+	std::vector<T> robots;
+	double build_total = 0, sim_total = 0;
+	benchmark::Run(result, opt,
+		[&]() { robots = proto; },
+		[&]() {
+			auto start = std::chrono::high_resolution_clock::now();
+			T::BatchBuild(robots, threads);
+			auto built = std::chrono::high_resolution_clock::now();
+
+			std::vector<Element> elements;
+			for(const T& R : robots) elements.push_back(R);
+			if(result.springs == 0) {
+				result.masses = robots[0].getMasses().size();
+				for(const T& R : robots) result.springs += R.getSprings().size();
+				// work is only known after the first build; Run divides by it afterwards
+				result.work = (double) result.springs * opt.steps;
+			}
+			sim.Reset();
+			sim.SetElements(elements);
+			sim.Simulate(sim_time);
+			auto end = std::chrono::high_resolution_clock::now();
+
+			build_total += std::chrono::duration<double>(built - start).count();
+			sim_total += std::chrono::duration<double>(end - built).count();
+		});
+
+	uint runs = opt.warmup + opt.repetitions;
+	result.build_time = build_total / runs;
+	result.sim_time = sim_total / runs;
+	return result;
+}
 
-		// NNRobot::BatchBuild(robots);
+// Sweeps thread count x batch size x robot size over the build + simulate
+// pipeline. Efficiency is throughput(threads) / (threads * throughput(1)).
+std::vector<benchmark::Result> ScalingBenchmark(const benchmark::Options& opt) {
+	printf("BENCHMARKING %s SCALING\n", opt.robot == "nn" ? "NN" : "VOXEL");
+	std::vector<benchmark::Result> results;
+
+	std::vector<uint> thread_counts = opt.thread_counts;
+	if(thread_counts.empty()) {
+		uint hardware = std::max(1u, std::thread::hardware_concurrency());
+		for(uint t = 1; t < hardware; t *= 2) thread_counts.push_back(t);
+		thread_counts.push_back(hardware);
+	}
 
-		for(auto& R : robots) {
-			robot_elements.push_back(R);
+	std::vector<uint> sizes = opt.robot_sizes;
+	if(sizes.empty()) sizes = {(uint) (opt.robot == "nn" ? DEFAULT_NN_SIZE : DEFAULT_VOXEL_SIZE)};
+
+	std::ostringstream csv;
+	csv << "robot, size, batch, threads, masses, springs, steps, build_s, sim_s, total_s, throughput, efficiency\n";
+
+	for(uint size : sizes) {
+		for(uint batch : opt.batch_sizes) {
+			std::vector<NNRobot> nn_proto;
+			std::vector<VoxelRobot> voxel_proto;
+			if(opt.robot == "nn") nn_proto = MakeNNRobots(batch, size);
+			else voxel_proto = std::vector<VoxelRobot>(batch, MakeVoxelRobot(size));
+
+			double base_throughput = 0;
+			for(uint threads : thread_counts) {
+				benchmark::Result r = (opt.robot == "nn") ?
+					ScalingCase(nn_proto, size, threads, opt) :
+					ScalingCase(voxel_proto, size, threads, opt);
+
+				// relative to the smallest thread count in the sweep (normally 1)
+				if(threads == thread_counts[0]) base_throughput = r.throughput / thread_counts[0];
+				r.efficiency = base_throughput > 0 ? r.throughput / (threads * base_throughput) : 0;
+
+				benchmark::Print(r);
+				printf("\t%u threads: build %f s, sim %f s, efficiency %.2f\n",
+					threads, r.build_time, r.sim_time, r.efficiency);
+
+				csv << opt.robot << ", " << size << ", " << batch << ", " << threads << ", "
+					<< r.masses << ", " << r.springs << ", " << r.steps << ", "
+					<< r.build_time << ", " << r.sim_time << ", " << r.mean << ", "
+					<< r.throughput << ", " << r.efficiency << "\n";
+				results.push_back(r);
+			}
 		}
+	}
 
-		
-		// printf("POPULATION SIZE:\t%u ROBOTS\n", pop_size);
-		
-		std::vector<ElementTracker> trackers = sim.SetElements(robot_elements);
-
-		printf("STARTED\n");
-		start = std::chrono::high_resolution_clock::now();
-		
-		sim.Simulate(MAX_TIME);
-		end = std::chrono::high_resolution_clock::now();
-		printf("FINISHED\n\n");
-
-		std::vector<Element> results = sim.Collect(trackers);
-
-		execute_time = std::chrono::duration<float>(end - start).count();
+	util::WriteCSV("scaling.csv", out_dir, csv.str());
+	printf("WROTE %s/scaling.csv\n", out_dir.c_str());
+	return results;
+}
 
-		num_springs = 0;
-		for(auto& R : robot_elements) {
-			num_springs += R.springs.size();
+// Times whole generations of the NN optimizer (variation, build,
+// evaluation, sorting and replacement) for each population size. One run
+// is budgeted for about warmup + repetitions generations of evaluations,
+// and the first warmup generations are discarded.
+std::vector<benchmark::Result> GenerationBenchmark(const benchmark::Options& opt) {
+	printf("BENCHMARKING NN GENERATIONS\n");
+	std::vector<benchmark::Result> results;
+
+	std::vector<uint> sizes = opt.robot_sizes;
+	if(sizes.empty()) sizes = {DEFAULT_NN_SIZE};
+
+	for(uint size : sizes) {
+		for(uint pop_size : opt.pop_sizes) {
+			OptimizerConfig opt_config(config);
+			opt_config.nnrobot.massCount = size;
+			opt_config.optimizer.pop_size = pop_size;
+			opt_config.optimizer.max_evals = (int) (pop_size * (1 + opt.warmup + opt.repetitions));
+			opt_config.optimizer.save_skip = std::numeric_limits<int>::max();
+			opt_config.io.out_dir = out_dir;
+			opt_config.io.base_dir = out_dir;
+			// Initialize applies the config's perf flag, keep the one from --perf
+			opt_config.hardware.perf_counters = util::perf::Enabled();
+			NNRobot::Configure(opt_config.nnrobot);
+			Evaluator<NNRobot>::Initialize(opt_config);
+
+			Optimizer<NNRobot> O;
+			O.Solve(opt_config);
+
+			benchmark::Result result;
+			result.name = "generation";
+			result.batch = pop_size;
+			result.size = size;
+			result.masses = size;
+			result.unit = "robots/s";
+
+			// a generation evaluates its children (and injected robots), not
+			// the whole population
+			const std::vector<float>& times = O.getGenerationTimes();
+			const std::vector<ulong>& evaluations = O.getGenerationEvaluations();
+			ulong evaluated = 0;
+			for(size_t i = opt.warmup; i < times.size(); i++) {
+				result.times.push_back(times[i]);
+				evaluated += evaluations[i];
+			}
+			if(!result.times.empty()) result.work = (double) evaluated / result.times.size();
+			benchmark::Summarize(result);
+
+			benchmark::Print(result);
+			results.push_back(result);
 		}
-		num_springs = num_springs * (MAX_TIME / sim.getDeltaT());
-		float springs_per_sec = num_springs / execute_time;
+	}
+	return results;
+}
 
-		fprintf(pFile,"%lu,%lu,%f,%f\n", num_springs, R.getSprings().size()*pop_size,execute_time,springs_per_sec);
-		printf("%u ROBOTS (%.2e SPRINGS) IN %f SECONDS\n", pop_size, (float) num_springs, execute_time);
-		printf("%.2e SPRINGS PER SECOND\n", (float) springs_per_sec);
-		printf("--------------------------\n");
+void handle_commandline_args(int argc, char** argv) {
+	int i = 1;
+	if(argc > 1 && std::string(argv[1]).rfind("--", 0) != 0) {
+		scenario = std::string(argv[1]);
+		i++;
+	}
 
-		pop_size *= 2;
-	} while(num_springs < MAX_SPRINGS);
-	fclose(pFile);
+	for(; i < argc; i++) {
+		std::string arg(argv[i]);
+		if(i+1 >= argc) {
+			std::cerr << "Missing value for benchmark option " << arg << std::endl;
+			break;
+		}
+		std::string value(argv[++i]);
+
+		if(arg == "--batch") {
+			options.batch_sizes = benchmark::ParseList(value);
+		} else if(arg == "--size") {
+			options.robot_sizes = benchmark::ParseList(value);
+		} else if(arg == "--threads") {
+			options.thread_counts = benchmark::ParseList(value);
+		} else if(arg == "--robot") {
+			options.robot = value;
+		} else if(arg == "--pop") {
+			options.pop_sizes = benchmark::ParseList(value);
+		} else if(arg == "--alpha") {
+			if(value == "optimal") {
+				config.nnrobot.alpha_mode = ALPHA_OPTIMAL;
+			} else if(value == "cached") {
+				config.nnrobot.alpha_mode = ALPHA_CACHED;
+			} else {
+				config.nnrobot.alpha_mode = ALPHA_FIXED;
+				config.nnrobot.alpha = std::stof(value);
+			}
+		} else if(arg == "--mesh") {
+			if(value == "alpha") {
+				config.nnrobot.mesh_type = MESH_ALPHA;
+			} else if(value == "lattice") {
+				config.nnrobot.mesh_type = MESH_LATTICE;
+			} else {
+				std::cerr << "Mesh type " << value << " not supported" << std::endl;
+			}
+		} else if(arg == "--steps") {
+			options.steps = std::stoul(value);
+		} else if(arg == "--warmup") {
+			options.warmup = std::stoul(value);
+		} else if(arg == "--reps") {
+			options.repetitions = std::stoul(value);
+		} else if(arg == "--json") {
+			options.json_file = value;
+		} else if(arg == "--baseline") {
+			options.baseline_file = value;
+		} else if(arg == "--tolerance") {
+			options.tolerance = std::stof(value);
+		} else if(arg == "--perf") {
+			util::perf::Enable(value == "1" || value == "true");
+		} else {
+			std::cerr << "Benchmark option " << arg << " not supported" << std::endl;
+		}
+	}
 }
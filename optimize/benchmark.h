@@ -0,0 +1,235 @@
+#ifndef __BENCHMARK_H__
+#define __BENCHMARK_H__
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace benchmark {
+
+struct Options {
+	std::vector<uint> batch_sizes = {1, 8, 64, 512};
+	std::vector<uint> robot_sizes = {};	// scenario default when empty
+	std::vector<uint> thread_counts = {};	// scaling scenario, powers of two up to hardware threads when empty
+	std::string robot = "voxel";		// scaling scenario robot type {voxel, nn}
+	std::vector<uint> pop_sizes = {512};	// generation scenario population sizes
+	uint steps = 100;
+	uint warmup = 1;
+	uint repetitions = 5;
+	float tolerance = 0.1f;				// allowed relative throughput drop
+	std::string json_file = "";
+	std::string baseline_file = "";
+};
+
+struct Result {
+	std::string name;
+	uint batch = 0;
+	uint size = 0;
+	uint threads = 0;
+	ulong masses = 0;
+	ulong springs = 0;
+	uint steps = 0;
+
+	// per repetition wall times in seconds
+	std::vector<double> times;
+	double mean = 0;
+	double stddev = 0;
+	double min = 0;
+	double max = 0;
+
+	// units of work per repetition (e.g. springs*steps, robots)
+	double work = 0;
+	std::string unit = "";
+	double throughput = 0;
+	double throughput_stddev = 0;
+
+	// scaling scenario: wall time split and efficiency relative to one thread
+	double build_time = 0;
+	double sim_time = 0;
+	double efficiency = 0;
+};
+
+// Fills in the statistics of result from its per repetition times
+inline void Summarize(Result& result) {
+	size_t n = result.times.size();
+	if(n == 0) return;
+
+	double sum = 0, tsum = 0;
+	result.min = result.max = result.times[0];
+	for(double t : result.times) {
+		sum += t;
+		tsum += result.work / t;
+		if(t < result.min) result.min = t;
+		if(t > result.max) result.max = t;
+	}
+	result.mean = sum / n;
+	result.throughput = tsum / n;
+
+	double var = 0, tvar = 0;
+	for(double t : result.times) {
+		var += (t - result.mean) * (t - result.mean);
+		tvar += (result.work / t - result.throughput) * (result.work / t - result.throughput);
+	}
+	result.stddev = n > 1 ? sqrt(var / (n-1)) : 0.0;
+	result.throughput_stddev = n > 1 ? sqrt(tvar / (n-1)) : 0.0;
+}
+
+// Runs setup() before every repetition, then times body().
+// Warmup repetitions are executed but discarded.
+inline void Run(Result& result, const Options& opt,
+				const std::function<void()>& setup,
+				const std::function<void()>& body) {
+	result.times.clear();
+	for(uint i = 0; i < opt.warmup + opt.repetitions; i++) {
+		setup();
+
+		auto start = std::chrono::high_resolution_clock::now();
+		body();
+		auto end = std::chrono::high_resolution_clock::now();
+
+		if(i >= opt.warmup)
+			result.times.push_back(std::chrono::duration<double>(end - start).count());
+	}
+
+	Summarize(result);
+}
+
+inline void Print(const Result& r) {
+	printf("%-8s batch %5u size %5u (%lu masses, %lu springs, %u steps)\n",
+		r.name.c_str(), r.batch, r.size, r.masses, r.springs, r.steps);
+	printf("\t%f +/- %f SECONDS [%f, %f]\n", r.mean, r.stddev, r.min, r.max);
+	printf("\t%.3e +/- %.2e %s\n", r.throughput, r.throughput_stddev, r.unit.c_str());
+}
+
+inline std::string ToJSON(const std::string& scenario, const Options& opt, const std::vector<Result>& results) {
+	std::ostringstream os;
+	os.precision(9);
+	os << "{\n";
+	os << "  \"scenario\": \"" << scenario << "\",\n";
+	os << "  \"warmup\": " << opt.warmup << ",\n";
+	os << "  \"repetitions\": " << opt.repetitions << ",\n";
+	os << "  \"results\": [\n";
+	for(size_t i = 0; i < results.size(); i++) {
+		const Result& r = results[i];
+		// one result per line so baselines can be read back line by line
+		os << "    {\"name\": \"" << r.name << "\""
+		   << ", \"batch\": " << r.batch
+		   << ", \"size\": " << r.size
+		   << ", \"threads\": " << r.threads
+		   << ", \"masses\": " << r.masses
+		   << ", \"springs\": " << r.springs
+		   << ", \"steps\": " << r.steps
+		   << ", \"mean_s\": " << r.mean
+		   << ", \"stddev_s\": " << r.stddev
+		   << ", \"min_s\": " << r.min
+		   << ", \"max_s\": " << r.max
+		   << ", \"throughput\": " << r.throughput
+		   << ", \"throughput_stddev\": " << r.throughput_stddev
+		   << ", \"build_s\": " << r.build_time
+		   << ", \"sim_s\": " << r.sim_time
+		   << ", \"efficiency\": " << r.efficiency
+		   << ", \"unit\": \"" << r.unit << "\"}"
+		   << (i < results.size()-1 ? ",\n" : "\n");
+	}
+	os << "  ]\n";
+	os << "}\n";
+	return os.str();
+}
+
+// Extracts the value following "key": on a single JSON line
+inline std::string FieldValue(const std::string& line, const std::string& key) {
+	std::string token = "\"" + key + "\":";
+	size_t pos = line.find(token);
+	if(pos == std::string::npos) return "";
+	pos += token.size();
+	while(pos < line.size() && line[pos] == ' ') pos++;
+
+	size_t end;
+	if(line[pos] == '"') {
+		pos++;
+		end = line.find('"', pos);
+	} else {
+		end = line.find_first_of(",}", pos);
+	}
+	if(end == std::string::npos) return "";
+	return line.substr(pos, end - pos);
+}
+
+inline std::vector<Result> ReadResults(const std::string& filename) {
+	std::vector<Result> results;
+	std::ifstream infile(filename);
+	if(!infile.is_open()) {
+		std::cerr << "Error opening benchmark baseline: " << filename << std::endl;
+		return results;
+	}
+
+	std::string line;
+	while(std::getline(infile, line)) {
+		if(FieldValue(line, "name") == "") continue;
+		Result r;
+		r.name = FieldValue(line, "name");
+		r.batch = std::stoul(FieldValue(line, "batch"));
+		r.size = std::stoul(FieldValue(line, "size"));
+		if(FieldValue(line, "threads") != "")
+			r.threads = std::stoul(FieldValue(line, "threads"));
+		r.steps = std::stoul(FieldValue(line, "steps"));
+		r.mean = std::stod(FieldValue(line, "mean_s"));
+		r.throughput = std::stod(FieldValue(line, "throughput"));
+		r.unit = FieldValue(line, "unit");
+		results.push_back(r);
+	}
+	return results;
+}
+
+// Returns the number of cases whose throughput fell more than
+// opt.tolerance below the matching baseline case
+inline int CompareToBaseline(const std::vector<Result>& results, const Options& opt) {
+	std::vector<Result> baseline = ReadResults(opt.baseline_file);
+	int regressions = 0;
+
+	printf("----BASELINE %s----\n", opt.baseline_file.c_str());
+	for(const Result& r : results) {
+		const Result* match = nullptr;
+		for(const Result& b : baseline) {
+			if(b.name == r.name && b.batch == r.batch && b.size == r.size &&
+			   b.steps == r.steps && b.threads == r.threads) {
+				match = &b;
+				break;
+			}
+		}
+		if(match == nullptr) {
+			printf("%-8s batch %5u size %5u: no baseline\n", r.name.c_str(), r.batch, r.size);
+			continue;
+		}
+
+		double ratio = r.throughput / match->throughput;
+		bool regressed = ratio < 1.0 - opt.tolerance;
+		if(regressed) regressions++;
+		printf("%-8s batch %5u size %5u: %.3e vs %.3e (%+.1f%%)%s\n",
+			r.name.c_str(), r.batch, r.size,
+			r.throughput, match->throughput, 100.0 * (ratio - 1.0),
+			regressed ? " REGRESSION" : "");
+	}
+	printf("%d REGRESSIONS\n", regressions);
+	return regressions;
+}
+
+inline std::vector<uint> ParseList(const std::string& s) {
+	std::vector<uint> values;
+	std::istringstream ss(s);
+	std::string cell;
+	while(std::getline(ss, cell, ',')) {
+		values.push_back(std::stoul(cell));
+	}
+	return values;
+}
+
+}
+
+#endif
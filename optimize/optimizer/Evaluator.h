@@ -4,8 +4,12 @@
 #include "candidate.h"
 #include "Simulator.h"
 #include "optimizer_config.h"
+#include "trace.h"
+#include "pareto.h"
 #include <vector>
+#include <numeric>
 #include <algorithm>
+#include <cmath>
 
 template<typename T>
 class Evaluator {
@@ -14,6 +18,22 @@ public:
     static Simulator Sim;
     static float baselineTime;
     static float evaluationTime;
+    static uint rungs;
+    static float rungKeep;
+    static bool gaitStop;
+    static float gaitTolerance;
+    // Springs actuate at OMEGA/2, OMEGA and 2*OMEGA, and composite springs
+    // at the averages of two (0.75, 1.25 and 1.5 OMEGA). All of their
+    // periods divide 8pi/OMEGA, the shortest time after which every spring
+    // is back in phase.
+    static constexpr float gaitPeriod = 8.0f * M_PI / (OMEGA);
+    // Gaits are checked this many times per period, each time against the
+    // state one period earlier, so a robot can stop at any quarter period
+    static constexpr uint gaitChecks = 4;
+    static bool settle;
+    static float settleEnergy;
+    static float settleStrain;
+    static float settleWindow;
     static float devoTime;
     static float devoCycles;
     static Config::Simulator sim_config;
@@ -22,42 +42,61 @@ public:
 
     static void Initialize(OptimizerConfig config);
     static void BatchEvaluate(std::vector<T>&, bool trace = false);
+    static std::vector<ElementTracker> Repack(const std::vector<Element>& elements);
+    static std::vector<float> SettleBaseline(std::vector<Element>& elements, std::vector<ElementTracker> trackers);
+    static void GaitSignature(const T& R, std::vector<float>& signature);
+    static bool GaitRepeats(const T& R, const std::vector<float>& signature, const std::vector<float>& previous,
+        float step, float previousStep);
 
+    // Pareto layers from a compact copy of the objectives
     static void pareto_classify(typename std::vector<T>::iterator begin, typename std::vector<T>::iterator end) {
+        const size_t dims = T::objective_count;
+        std::vector<float> objectives((end - begin) * dims);
         for(auto i = begin; i < end; i++) {
-            i->mParetoLayer = 0;
+            i->objectives(&objectives[(i - begin) * dims]);
         }
 
-        int Delta;
-        uint run = 0;
-        while(true) {
-            Delta = 0;
-            for(auto i = begin; i < end; i++) {
-                if(i->mParetoLayer < run) continue;
-                for(auto j = begin; j < end; j++) {
-                    if(j->mParetoLayer < run || i == j) continue;
-                    if(j->dominates(*i)) {
-                        i->mParetoLayer++;
-                        Delta++;
-                        break;
-                    }
-                }
-            }
-            if(Delta == 0) break;
-            run++;
+        std::vector<uint> layers;
+        pareto::Classify(objectives, dims, layers);
+        for(auto i = begin; i < end; i++) {
+            i->mParetoLayer = layers[i - begin];
         }
     }
 
+    // Sorts by layer, then fitness. Indices are sorted over a compact key
+    // table and the robots are then permuted in place with swaps, so no
+    // robot is copied.
     static void pareto_sort(typename std::vector<T>::iterator begin, typename std::vector<T>::iterator end) {
+        TRACE_SCOPE("pareto_sort");
         pareto_classify(begin, end);
-        std::sort(begin,end,[](const T a, const T b) {
-            if(a > b)
-                return true;
-            else if(a.paretoLayer() == b.paretoLayer())
-                return a.fitness() > b.fitness();
-            
-            return false;
+
+        size_t count = end - begin;
+        std::vector<uint> layers(count);
+        std::vector<float> fitness(count);
+        for(size_t i = 0; i < count; i++) {
+            layers[i] = begin[i].paretoLayer();
+            fitness[i] = begin[i].fitness();
+        }
+
+        std::vector<uint32_t> order(count);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            if(layers[a] != layers[b]) return layers[a] < layers[b];
+            if(fitness[a] != fitness[b]) return fitness[a] > fitness[b];
+            return a < b;
         });
+
+        // position k takes the robot at order[k], one cycle at a time
+        std::vector<bool> placed(count, false);
+        for(size_t k = 0; k < count; k++) {
+            if(placed[k]) continue;
+            placed[k] = true;
+            for(size_t j = k; order[j] != k; j = order[j]) {
+                using std::swap;
+                swap(begin[j], begin[order[j]]);
+                placed[order[j]] = true;
+            }
+        }
     }
 };
 
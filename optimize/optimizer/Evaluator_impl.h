@@ -2,6 +2,9 @@
 #define __EVALUATOR_IMPL_H__
 
 #include "Evaluator.h"
+#include "perf_counters.h"
+#include <cmath>
+#include <string>
 
 template<typename T>
 ulong Evaluator<T>::eval_count = 0;
@@ -18,6 +21,30 @@ float Evaluator<T>::baselineTime = 5.0f;
 template<typename T>
 float Evaluator<T>::evaluationTime = 10.0f;
 
+template<typename T>
+uint Evaluator<T>::rungs = 1;
+
+template<typename T>
+float Evaluator<T>::rungKeep = 0.5f;
+
+template<typename T>
+bool Evaluator<T>::gaitStop = false;
+
+template<typename T>
+float Evaluator<T>::gaitTolerance = 0.01f;
+
+template<typename T>
+bool Evaluator<T>::settle = false;
+
+template<typename T>
+float Evaluator<T>::settleEnergy = 1e-3f;
+
+template<typename T>
+float Evaluator<T>::settleStrain = 0.01f;
+
+template<typename T>
+float Evaluator<T>::settleWindow = 0.25f;
+
 template<typename T>
 Config::Simulator Evaluator<T>::sim_config = Config::Simulator();
 
@@ -30,14 +57,24 @@ void Evaluator<T>::Initialize(OptimizerConfig config) {
     sim_config = config.simulator;
     baselineTime = config.evaluator.base_time;
     evaluationTime = config.evaluator.eval_time;
+    rungs = std::max(config.evaluator.rungs, 1);
+    rungKeep = std::min(std::max(config.evaluator.rung_keep, 0.01f), 1.0f);
+    gaitStop = config.evaluator.gait_stop;
+    gaitTolerance = config.evaluator.gait_tolerance;
+    settle = config.evaluator.settle;
+    settleEnergy = config.evaluator.settle_energy;
+    settleStrain = config.evaluator.settle_strain;
+    settleWindow = std::max(config.evaluator.settle_window, 0.01f);
     devoTime = config.devo.devo_time;
     devoCycles = config.devo.devo_cycles;
 	Sim.Initialize(sim_config);
+    util::perf::Enable(config.hardware.perf_counters);
 }
 
 template<typename T>
 void Evaluator<T>::BatchEvaluate(std::vector<T>& solutions, bool trace) {
     if(solutions.size() == 0) return;
+    TRACE_SCOPE("BatchEvaluate");
     printf("EVALUATING %lu SOLUTIONS\n",solutions.size());
 
     Sim.Reset();
@@ -60,50 +97,328 @@ void Evaluator<T>::BatchEvaluate(std::vector<T>& solutions, bool trace) {
         i++;
     }
 
-    std::vector<ElementTracker> trackers = Sim.SetElements(elements);
+    // nothing to simulate when every robot was screened out
+    if(elements.size() == 0) {
+        for(T& R : solutions) {
+            eval_count++;
+            R.updateFitness();
+        }
+        return;
+    }
+
+    std::vector<ElementTracker> trackers;
+    {
+        TRACE_SCOPE("SetElements", "simulate");
+        trackers = Sim.SetElements(elements);
+    }
 
     
     for(uint i = 0; i < devoCycles; i++) {
+        TRACE_SCOPE("Devo", "simulate");
         Sim.Simulate(devoTime, true);
 
         Sim.Devo();
     }
 
-    Sim.Simulate(baselineTime);
-    results = Sim.Collect(trackers);
+    {
+        TRACE_SCOPE("Baseline", "simulate");
+        if(settle) {
+            SettleBaseline(elements, trackers);
+            results.swap(elements);
+        } else {
+            Sim.Simulate(baselineTime);
+            results = Sim.Collect(trackers);
+        }
+    }
 
+    // Settled robots are measured from where they came to rest, otherwise
+    // every robot starts again from its build pose
     skip_count = 0;
     elements.clear();
     for(uint i = 0; i < solutions.size(); i++) {
         if(robotWasAllocated[i]) {
             solutions[i].Update(results[i - skip_count]);
-            solutions[i].Reset();
+            if(settle) {
+                solutions[i].updateBaseline();
+                solutions[i].resetSimTime();
+            } else {
+                solutions[i].Reset();
+            }
             elements.push_back(solutions[i]);
         } else {
             skip_count++;
         }
     }
     Sim.Reset();
-    trackers = Sim.SetElements(elements); // this can be parallelized!!
+    {
+        TRACE_SCOPE("SetElements", "simulate");
+        trackers = Sim.SetElements(elements); // this can be parallelized!!
+    }
     
+    // The measured phase runs from stop to stop: rung horizons for
+    // successive halving (every robot runs the first rung, the best
+    // rungKeep of each rung continue to the next, longer one) and, with
+    // gait detection, every quarter gait period. Robots that continue
+    // resume from their collected state, and the simulator clock is not
+    // reset, so actuation stays in phase.
+    std::vector<uint> active; // solution index of each simulated element
+    for(uint i = 0; i < solutions.size(); i++) {
+        if(robotWasAllocated[i]) active.push_back(i);
+    }
+    size_t allocatedCount = active.size();
+    uint rungCount = std::max(rungs, 1u);
+    auto rungHorizon = [&](uint r) { return evaluationTime * std::pow(rungKeep, (float) (rungCount-1-r)); };
+
+    std::vector<float> stops;
+    for(uint r = 0; r < rungCount; r++) stops.push_back(rungHorizon(r));
+    const float gaitCheck = gaitPeriod / gaitChecks;
+    if(gaitStop) {
+        for(uint k = 1; k * gaitCheck < evaluationTime; k++) stops.push_back(k * gaitCheck);
+    }
+    std::sort(stops.begin(), stops.end());
+    stops.erase(std::unique(stops.begin(), stops.end(), [](float a, float b) { return b - a < 1e-4f; }), stops.end());
+
+    std::vector<float> droppedAt(solutions.size(), 0.0f); // horizon of robots dropped by a rung
+    std::vector<bool> periodic(solutions.size(), false);  // stopped with a repeating gait
+    // per robot, the signatures of the last period and the COM x of the
+    // last two, one per gait check, indexed by check number modulo size
+    std::vector<std::vector<std::vector<float>>> signature(solutions.size());
+    std::vector<std::vector<float>> pastX(solutions.size());
+    if(gaitStop) {
+        for(uint i : active) {
+            signature[i].resize(gaitChecks);
+            pastX[i].assign(2 * gaitChecks, NAN);
+            GaitSignature(solutions[i], signature[i][0]);
+            pastX[i][0] = solutions[i].getBaseCOM().x();
+        }
+    }
+    uint periodicCount = 0;
+
+    float elapsed = 0.0f;
+    float simulated = 0.0f; // robot-seconds, to report the saving
+    uint rung = 0;
+    std::string rungReadout;
+    std::vector<float> current;
+
     static int trace_count = 0;
-    Sim.Simulate(evaluationTime, false, trace, std::string("sim_trace_") + std::to_string(trace_count) + std::string(".csv"));
+    for(float stop : stops) {
+        {
+            TRACE_SCOPE("Evaluate", "simulate");
+            Sim.Simulate(stop - elapsed, false, trace, std::string("sim_trace_") + std::to_string(trace_count) + std::string(".csv"));
+            results = Sim.Collect(trackers);
+        }
+        simulated += active.size() * (stop - elapsed);
+        elapsed = stop;
+
+        for(size_t k = 0; k < active.size(); k++) {
+            solutions[active[k]].Update(results[k]);
+        }
+        std::vector<bool> keep(active.size(), true);
+
+        uint check = (uint) std::lround(stop / gaitCheck);
+        if(gaitStop && std::abs(stop - check * gaitCheck) < 1e-3f) {
+            auto x = [&](uint i, uint c) { return pastX[i][c % pastX[i].size()]; };
+            for(size_t k = 0; k < active.size(); k++) {
+                T& R = solutions[active[k]];
+                uint i = active[k];
+                float now = R.getCOM().x();
+                GaitSignature(R, current);
+                // distance walked over the last period, and over the period
+                // ending one check earlier
+                if(check > gaitChecks) {
+                    float step = now - x(i, check - gaitChecks);
+                    float previousStep = x(i, check - 1) - x(i, check - 1 - gaitChecks);
+                    if(GaitRepeats(R, current, signature[i][check % gaitChecks], step, previousStep)) {
+                        // the rest of the run repeats the last period
+                        float end = now + step * (evaluationTime - stop) / gaitPeriod;
+                        R.setFitness(std::max((end - R.getBaseCOM().x()) / R.getLength(), 0.0f), true);
+                        periodic[i] = true;
+                        periodicCount++;
+                        keep[k] = false;
+                    }
+                }
+                signature[i][check % gaitChecks].swap(current);
+                pastX[i][check % pastX[i].size()] = now;
+            }
+        }
+
+        if(rung < rungCount && stop >= rungHorizon(rung) - 1e-4f) {
+            rungReadout += (rung > 0 ? " -> " : "") + std::to_string(active.size());
+            rung++;
+            std::vector<uint32_t> order;
+            for(size_t k = 0; k < active.size(); k++) {
+                if(keep[k]) order.push_back(k);
+            }
+            size_t survivors = std::max<size_t>(1, std::ceil(rungKeep * order.size()));
+            if(rung < rungCount && survivors < order.size()) {
+                std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+                    return solutions[active[a]].fitness() > solutions[active[b]].fitness();
+                });
+                for(size_t k = survivors; k < order.size(); k++) {
+                    droppedAt[active[order[k]]] = stop;
+                    keep[order[k]] = false;
+                }
+            }
+        }
+
+        // only robots still running take simulator blocks
+        if(std::find(keep.begin(), keep.end(), false) == keep.end()) continue;
+        // the solutions hold the collected state along with the faces and
+        // boundary masses drag needs, which Collect does not return
+        std::vector<uint> next;
+        elements.clear();
+        for(size_t k = 0; k < active.size(); k++) {
+            if(!keep[k]) continue;
+            next.push_back(active[k]);
+            elements.push_back(solutions[active[k]]);
+        }
+        active.swap(next);
+        if(active.empty()) break;
+        trackers = Repack(elements);
+    }
     if(trace) trace_count++;
-    results = Sim.Collect(trackers);
 
-    skip_count = 0;
     for(uint i = 0; i < solutions.size(); i++) {
-        if(robotWasAllocated[i]) {
-            solutions[i].Update(results[i - skip_count]);
-        } else {
-            skip_count++;
+        eval_count++;
+        if(!periodic[i]) solutions[i].updateFitness();
+    }
+
+    // Robots dropped by a rung are estimated at the full horizon, but never
+    // above a robot that outlasted them
+    if(rungCount > 1) {
+        float lowestFull = INFINITY;
+        for(uint i = 0; i < solutions.size(); i++) {
+            if(robotWasAllocated[i] && droppedAt[i] == 0.0f) lowestFull = std::min(lowestFull, solutions[i].fitness());
+        }
+        for(uint i = 0; i < solutions.size(); i++) {
+            if(droppedAt[i] == 0.0f) continue;
+            solutions[i].setFitness(std::min(solutions[i].fitness() * evaluationTime / droppedAt[i], lowestFull), true);
         }
+        printf("RUNGS: %s robots\n", rungReadout.data());
+    }
+    if(rungCount > 1 || gaitStop) {
+        printf("EARLY STOP: %u of %lu robots periodic, %.0f%% of full length simulation\n",
+            periodicCount, allocatedCount, 100.0f * simulated / (evaluationTime * allocatedCount));
     }
+}
 
-    for(T& R : solutions) {
-        eval_count++;
-        R.updateFitness();
+// Packs the elements still running into the simulator without restarting
+// its clock, so their actuation stays in phase
+template<typename T>
+std::vector<ElementTracker> Evaluator<T>::Repack(const std::vector<Element>& elements) {
+    TRACE_SCOPE("SetElements", "simulate");
+    float time = Sim.getTotalTime();
+    std::vector<ElementTracker> trackers = Sim.SetElements(elements);
+    Sim.setTotalTime(time);
+    return trackers;
+}
+
+// Simulates the baseline in steps of a quarter window and checks every
+// element's motion after each. An element below both thresholds for
+// settleWindow is collected and repacked out of the simulator, so only the
+// restless ones keep running, up to baselineTime. elements are packed in
+// trackers and receive their final state. Returns when each element's
+// baseline ended, baselineTime for those that never settled.
+template<typename T>
+std::vector<float> Evaluator<T>::SettleBaseline(std::vector<Element>& elements, std::vector<ElementTracker> trackers) {
+    size_t count = elements.size();
+    std::vector<float> ended(count, baselineTime);
+    std::vector<uint> active(count); // element index of each tracker
+    std::iota(active.begin(), active.end(), 0);
+    std::vector<float> quiet(count, 0.0f);
+
+    float chunk = settleWindow / 4.0f;
+    float elapsed = 0.0f;
+    float simulated = 0.0f; // robot-seconds, to report the saving
+    uint settledCount = 0;
+    std::vector<Element> results;
+    while(!active.empty() && elapsed < baselineTime - 1e-4f) {
+        float step = std::min(chunk, baselineTime - elapsed);
+        Sim.Simulate(step);
+        elapsed += step;
+        simulated += active.size() * step;
+
+        std::vector<ElementMotion> motion = Sim.Motion(trackers);
+        bool anySettled = false;
+        for(size_t k = 0; k < active.size(); k++) {
+            if(motion[k].kinetic <= settleEnergy && motion[k].strain <= settleStrain) quiet[k] += step;
+            else quiet[k] = 0.0f;
+            anySettled |= quiet[k] >= settleWindow - 1e-4f;
+        }
+        if(!anySettled) continue;
+
+        // collected elements carry masses and springs only, the faces and
+        // boundary masses drag needs stay in elements
+        results = Sim.Collect(trackers);
+        std::vector<uint> next;
+        std::vector<float> nextQuiet;
+        std::vector<Element> restless;
+        for(size_t k = 0; k < active.size(); k++) {
+            Element& e = elements[active[k]];
+            e.masses = std::move(results[k].masses);
+            e.springs = std::move(results[k].springs);
+            if(quiet[k] >= settleWindow - 1e-4f) {
+                ended[active[k]] = elapsed;
+                settledCount++;
+            } else {
+                next.push_back(active[k]);
+                nextQuiet.push_back(quiet[k]);
+                restless.push_back(e);
+            }
+        }
+        active.swap(next);
+        quiet.swap(nextQuiet);
+        if(!active.empty()) trackers = Repack(restless);
+    }
+
+    if(!active.empty()) {
+        results = Sim.Collect(trackers);
+        for(size_t k = 0; k < active.size(); k++) {
+            elements[active[k]].masses = std::move(results[k].masses);
+            elements[active[k]].springs = std::move(results[k].springs);
+        }
+    }
+    printf("SETTLED: %u of %lu robots, baseline ended at %.2f of %.2f s, %.0f%% of full length simulation\n",
+        settledCount, count, elapsed, baselineTime, baselineTime > 0.0f ? 100.0f * simulated / (baselineTime * count) : 0.0f);
+    return ended;
+}
+
+// Shape and motion of a robot, wherever it has walked to: mass positions
+// relative to the center of mass in the ground plane, and velocities
+template<typename T>
+void Evaluator<T>::GaitSignature(const T& R, std::vector<float>& signature) {
+    Eigen::Vector3f origin = R.getCOM();
+    origin.y() = 0.0f;
+    signature.clear();
+    for(const Mass& m : R.getMasses()) {
+        if(m.material == materials::air) continue;
+        Eigen::Vector3f p = m.pos - origin;
+        signature.insert(signature.end(), {p.x(), p.y(), p.z(), m.vel.x(), m.vel.y(), m.vel.z()});
+    }
+}
+
+// Actuation is periodic and the ground is the same everywhere, so a robot
+// back in the same shape and motion one period later repeats that period
+// for good. The distance walked over the last period has to agree with
+// the one measured a check earlier as well.
+template<typename T>
+bool Evaluator<T>::GaitRepeats(const T& R, const std::vector<float>& signature, const std::vector<float>& previous,
+        float step, float previousStep) {
+    if(std::isnan(previousStep) || signature.empty() || signature.size() != previous.size()) return false;
+
+    float length = R.getLength();
+    if(std::abs(step - previousStep) > gaitTolerance * length) return false;
+
+    double pos = 0.0, vel = 0.0;
+    for(size_t j = 0; j < signature.size(); j += 6) {
+        for(size_t d = 0; d < 3; d++) {
+            pos += (signature[j+d] - previous[j+d]) * (signature[j+d] - previous[j+d]);
+            vel += (signature[j+3+d] - previous[j+3+d]) * (signature[j+3+d] - previous[j+3+d]);
+        }
     }
+    size_t count = signature.size() / 6;
+    return std::sqrt(pos / count) <= gaitTolerance * length &&
+           std::sqrt(vel / count) * gaitPeriod <= gaitTolerance * length;
 }
 
 #endif
\ No newline at end of file
@@ -22,6 +22,7 @@ protected:
     uint    mAge = 0;
     bool    mParentFlag = 0;
     bool    mValid = true;
+    bool    mEstimated = false; // fitness extrapolated from a shortened simulation
 
 public:
 
@@ -33,7 +34,8 @@ public:
         mParetoLayer(src.mParetoLayer),
         mAge(src.mAge),
         mParentFlag(src.mParentFlag),
-        mValid(src.mValid)
+        mValid(src.mValid),
+        mEstimated(src.mEstimated)
     {}
 
 
@@ -44,6 +46,7 @@ public:
         swap(c1.mAge,c2.mAge);
         swap(c1.mValid,c2.mValid);
         swap(c1.mParentFlag,c2.mParentFlag);
+        swap(c1.mEstimated,c2.mEstimated);
     }
 
     void IncrementAge() { mAge++; };
@@ -53,8 +56,9 @@ public:
     bool isParent() const { return mParentFlag; }
     uint age() const { return mAge; }
     uint paretoLayer() const { return mParetoLayer; }
+    bool fitnessEstimated() const { return mEstimated; }
 
-    void setFitness(float fit) { mFitness = fit; }
+    void setFitness(float fit, bool estimated = false) { mFitness = fit; mEstimated = estimated; }
     void setIsParent(bool on) { mParentFlag = on; }
 
 
@@ -93,8 +97,16 @@ public:
 
     virtual bool dominates(const Candidate&) const = 0;
 
+    // Objectives of the pareto sort, all maximized: higher fitness, lower
+    // age. Must agree with dominates.
+    static constexpr size_t objective_count = 2;
+    void objectives(float* out) const {
+        out[0] = mFitness;
+        out[1] = -(float) mAge;
+    }
+
     std::string fitnessReadout() {
-        return "fitness: " + std::to_string(mFitness) + "\tage: " + std::to_string(mAge);
+        return "fitness: " + std::to_string(mFitness) + (mEstimated ? " (estimated)" : "") + "\tage: " + std::to_string(mAge);
     }
 };
 
@@ -11,6 +11,9 @@
 #include <vector>
 #include "Evaluator.h"
 #include "optimizer_config.h"
+#include "lru_cache.h"
+#include "selection.h"
+#include "bounded_queue.h"
 
 template<typename T>
 using Solution = T*;
@@ -94,7 +97,9 @@ struct subpopulation {
 
 template<typename T>
 class Optimizer {
-    
+friend int TestPromoteAgeLayers();
+friend int TestMigrate();
+
 public:
     ulong max_evals = 1e4;
     
@@ -120,7 +125,14 @@ public:
     MutationStrat mutator = MUTATE;
     CrossoverStrat crossover = CROSS_DC;
     ReplacementStrat replacement = PARETO;
+    SelectionStrat selection = SELECT_ROULETTE;
+    uint tournament_size = 4;
     NichingStrat niche = NICHE_ALPS;
+    uint migrant_count = 2;
+    uint age_gap = 5;
+    EvolutionStrat evolution = EVOLVE_GENERATIONAL;
+    uint eval_batch = 64;
+    uint producer_count = 2;
 
     unsigned seed;
     std::default_random_engine gen;
@@ -148,28 +160,54 @@ private:
     std::vector<std::tuple<ulong,float>> fitness_history;
     std::vector<std::tuple<ulong,float>> diversity_history;
     std::vector<std::tuple<ulong,std::vector<float>,std::vector<float>>> population_history;
+    std::vector<float> generation_times; // wall seconds per generation of the last generational run
+    std::vector<ulong> generation_evaluations; // evaluations per generation of the same run
     std::vector<T> solutions;
     std::vector<T> pareto_solutions;
+
+    // keyed by T::GenomeHash, shared across generations and runs
+    util::LRUCache<uint64_t, typename T::Phenotype> phenotype_cache;
+    util::LRUCache<uint64_t, float> fitness_cache;
+    // robots built since the last report, and how many of them were invalid
+    ulong built_count = 0;
+    ulong rejected_count = 0;
+    void BuildAndEvaluate(std::vector<T>& robots);
+    void MaterializePhenotypes(typename std::vector<T>::iterator begin, typename std::vector<T>::iterator end);
     
     void RandomizePopulation(std::vector<T>& population);
     void RandomizeSolution(Solution<T>);
     void MutateSolution(Solution<T>);
     void SimulatedAnnealingStep(T&);
     void ChildStep(subpopulation<T>& subpop);
+    void GenerateChildren(subpopulation<T>& subpop);
+    void EvaluateChildren(const std::vector<subpopulation<T>*>& islands);
+    void ReplaceWithChildren(subpopulation<T>& subpop);
+    void IslandStep(void);
+    void Migrate(void);
+    uint AgeLimit(size_t layer);
+    void PromoteAgeLayers(ulong generation);
+    std::vector<uint32_t> RankPopulation(std::vector<T>& population, bool islands);
 
     void CalibrateStep(void);
     void Calibrate(void);
-    void SteadyStateReplace(subpopulation<T>& subpop, CandidatePair<T>& parents, CandidatePair<T>& children, size_t P1, size_t P2);
+    void ReleaseUnread(subpopulation<T>& subpop);
+    void SteadyStateReplace(subpopulation<T>& subpop, std::vector<T>& children);
     void SteadyStateMutate(T&);
-    void SteadyStateStep(subpopulation<T>&);
+    bool SteadyStateStep(subpopulation<T>& subpop, const selection::Selector& selector, util::BoundedQueue<T>& queue);
 
     void WriteSolutions(const std::vector<T>& solutions, const std::string& directory);
 
-    std::vector<T> NoNicheSolve();
+    void ReportGeneration(ulong generation, std::vector<T>& population, const std::vector<uint32_t>& ranking,
+        float seconds, ulong evaluations);
+    void SaveGeneration(ulong generation);
+
+    std::vector<T> GenerationalSolve();
+    std::vector<T> SteadyStateSolve();
 
 public:
     void reset(void) {
         Evaluator<T>::eval_count = 0;
+        T::ResetBuildCache();
         solution_history.clear();
         fitness_history.clear();
         population_history.clear();
@@ -181,6 +219,8 @@ public:
     std::vector<std::tuple<ulong, T>>& getSolutionHistory() {return solution_history;}
     std::vector<std::tuple<ulong, float>>& getFitnessHistory() {return fitness_history;}
     std::vector<std::tuple<ulong,std::vector<float>,std::vector<float>>>& getPopulationHistory() {return population_history;}
+    std::vector<float>& getGenerationTimes() {return generation_times;}
+    std::vector<ulong>& getGenerationEvaluations() {return generation_evaluations;}
 };
 
 #include "optimizer_impl.h"
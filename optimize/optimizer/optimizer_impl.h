@@ -14,8 +14,15 @@
 #include <time.h>
 #include <memory>
 #include <cmath>
+#include <climits>
 #include <utility>
+#include <tuple>
+#include <numeric>
+#include <unordered_map>
 #include "optimizer_util.h"
+#include "perf_counters.h"
+#include "trace.h"
+#include "parallel.h"
 
 template<typename T>
 Optimizer<T>::Optimizer() {
@@ -33,6 +40,7 @@ Optimizer<T>::~Optimizer() {
 
 template<typename T>
 void Optimizer<T>::WriteSolutions(const std::vector<T>& solutions, const std::string& directory) {
+    TRACE_SCOPE("WriteSolutions");
     uint i = 0;
 
     util::WriteCSV("latest.txt",config.io.base_dir,directory);
@@ -49,28 +57,131 @@ void Optimizer<T>::WriteSolutions(const std::vector<T>& solutions, const std::st
 }
 
 template<typename T>
-std::vector<float> updateDiversity(std::vector<T> pop) {
+std::vector<float> updateDiversity(const std::vector<T>& pop) {
     return T::findDiversity(pop);
 }
 
+// Builds and evaluates robots, skipping genomes already seen. Each distinct
+// genome is built at most once per batch (or restored from the phenotype
+// cache) and simulated at most once (or given its cached fitness).
+// Cache hits count towards eval_count so the evaluation budget still
+// bounds the number of generations. Development (DEVO_CYCLES > 0) is
+// stochastic, so then a genome's fitness is not reused and every robot,
+// duplicates included, is simulated. Estimated fitness (early stopped
+// robots) is never cached; duplicates keep the estimate flag.
 template<typename T>
-void Optimizer<T>::RandomizePopulation(std::vector<T>& population) {
-    printf("RANDOMIZING\n");
-    for(uint i = 0; i < population.size(); i++) {
-        population[i].Randomize();
+void Optimizer<T>::BuildAndEvaluate(std::vector<T>& robots) {
+    std::vector<uint64_t> hashes(robots.size());
+    std::unordered_map<uint64_t, size_t> first; // first robot with each genome
+    std::vector<long> duplicateOf(robots.size(), -1);
+    for(size_t i = 0; i < robots.size(); i++) {
+        hashes[i] = robots[i].GenomeHash();
+        auto it = first.find(hashes[i]);
+        if(it == first.end()) first[hashes[i]] = i;
+        else duplicateOf[i] = it->second;
     }
 
-    std::vector<T> evalBuf;
-    for(uint i = 0; i < population.size(); i++) {
-        evalBuf.push_back(population[i]);
+    // Runs batch over the robots in idx, moving them out only when some
+    // robots are skipped
+    auto runSubset = [&](const std::vector<size_t>& idx, auto batch) {
+        if(idx.size() == robots.size()) {
+            batch(robots);
+            return;
+        }
+        std::vector<T> buf;
+        buf.reserve(idx.size());
+        for(size_t i : idx) buf.push_back(std::move(robots[i]));
+        batch(buf);
+        for(size_t k = 0; k < idx.size(); k++) robots[idx[k]] = std::move(buf[k]);
+    };
+
+    // Phenotypes
+    std::vector<size_t> toBuild;
+    typename T::Phenotype phenotype;
+    for(size_t i = 0; i < robots.size(); i++) {
+        if(duplicateOf[i] >= 0) continue;
+        if(phenotype_cache.get(hashes[i], phenotype)) robots[i].setPhenotype(phenotype);
+        else toBuild.push_back(i);
     }
-    
-    T::BatchBuild(evalBuf);
-    Evaluator<T>::BatchEvaluate(evalBuf);
+    runSubset(toBuild, [](std::vector<T>& buf) { T::BatchBuild(buf); });
+    for(size_t i : toBuild) {
+        phenotype_cache.put(hashes[i], robots[i].getPhenotype());
+    }
+
+    for(size_t i = 0; i < robots.size(); i++) {
+        if(duplicateOf[i] < 0) continue;
+        robots[i].setPhenotype(robots[duplicateOf[i]].getPhenotype());
+    }
+
+    // Fitness
+    bool reuseFitness = config.devo.devo_cycles == 0;
+    std::vector<size_t> toEvaluate;
+    float fitness;
+    for(size_t i = 0; i < robots.size(); i++) {
+        if(!reuseFitness) toEvaluate.push_back(i);
+        else if(duplicateOf[i] >= 0) continue;
+        else if(fitness_cache.get(hashes[i], fitness)) robots[i].setFitness(fitness);
+        else toEvaluate.push_back(i);
+    }
+    runSubset(toEvaluate, [](std::vector<T>& buf) { Evaluator<T>::BatchEvaluate(buf); });
+    if(reuseFitness) {
+        // extrapolated fitness is only comparable within its own batch
+        for(size_t i : toEvaluate) {
+            if(!robots[i].fitnessEstimated()) fitness_cache.put(hashes[i], robots[i].fitness());
+        }
+        for(size_t i = 0; i < robots.size(); i++) {
+            if(duplicateOf[i] < 0) continue;
+            const T& original = robots[duplicateOf[i]];
+            robots[i].setFitness(original.fitness(), original.fitnessEstimated());
+        }
+    }
+    Evaluator<T>::eval_count += robots.size() - toEvaluate.size();
+
+    built_count += robots.size();
+    for(const T& R : robots) {
+        if(!R.isValid()) rejected_count++;
+    }
+}
+
+// Gives released robots in [begin, end) their bodies back, from the
+// phenotype cache when possible and by rebuilding otherwise. Fitness is
+// not touched.
+template<typename T>
+void Optimizer<T>::MaterializePhenotypes(typename std::vector<T>::iterator begin, typename std::vector<T>::iterator end) {
+    TRACE_SCOPE("MaterializePhenotypes");
+    std::vector<typename std::vector<T>::iterator> missing;
+    std::vector<uint64_t> hashes;
+    std::vector<T> buf;
+    typename T::Phenotype phenotype;
+    for(auto i = begin; i < end; i++) {
+        if(i->hasPhenotype()) continue;
+        uint64_t hash = i->GenomeHash();
+        if(phenotype_cache.get(hash, phenotype)) {
+            i->setPhenotype(phenotype);
+            continue;
+        }
+        missing.push_back(i);
+        hashes.push_back(hash);
+        buf.push_back(std::move(*i));
+    }
+    if(buf.empty()) return;
 
+    T::BatchBuild(buf);
+    for(size_t k = 0; k < buf.size(); k++) {
+        phenotype_cache.put(hashes[k], buf[k].getPhenotype());
+        *missing[k] = std::move(buf[k]);
+    }
+}
+
+template<typename T>
+void Optimizer<T>::RandomizePopulation(std::vector<T>& population) {
+    TRACE_SCOPE("RandomizePopulation");
+    printf("RANDOMIZING\n");
     for(uint i = 0; i < population.size(); i++) {
-        population[i] = evalBuf[i];
+        population[i].Randomize();
     }
+
+    BuildAndEvaluate(population);
 }
 
 template<typename T>
@@ -86,46 +197,34 @@ void Optimizer<T>::MutateSolution(Solution<T> sol) {
 }
 
 template<typename T>
-size_t SelectRoulette(subpopulation<T>& subpop) {
-    std::vector<float> fitness(subpop.size());
-    float tot_fitness = 0;
-    for(auto i = subpop.begin(); i < subpop.end(); i++) {
-        tot_fitness += i->fitness();
-    }
-    for(auto i = subpop.begin(); i < subpop.end(); i++) {
-        fitness[i-subpop.begin()] = i->fitness() / tot_fitness;
-    }
-    
-    float random = ((float) rand() / (float) RAND_MAX);
-
-    size_t i = 0;
-    while(i < fitness.size()-1) {
-        random -= fitness[i];
-        if(random < 0) break;
-
-        i++;
-    }
-    
-    return i;
+void Optimizer<T>::ChildStep(subpopulation<T>& subpop) {
+    TRACE_SCOPE("ChildStep");
+    GenerateChildren(subpop);
+    EvaluateChildren({&subpop});
+    ReplaceWithChildren(subpop);
 }
 
+// Variation only touches the island's own robots and family buffers and
+// draws from thread local generators, so islands can run it concurrently
 template<typename T>
-void Optimizer<T>::ChildStep(subpopulation<T>& subpop) {
+void Optimizer<T>::GenerateChildren(subpopulation<T>& subpop) {
     //STEP 1: Generate new population of children
     uint num_children = subpop.size() * child_pop_size;
 
+    std::vector<float> fitness(subpop.size());
+    for(size_t i = 0; i < subpop.size(); i++) fitness[i] = subpop[i].fitness();
+    selection::Selector selector(selection, tournament_size);
+    selector.Prepare(fitness);
+    std::mt19937& rng = selection::ThreadRNG();
+
+    int64_t variation_begin = util::trace::Enabled() ? util::trace::Now() : 0;
     for(uint i = 0; i < num_children; i ++) {
-        if(uniform_real(gen) >= mutation_crossover_threshold) {
+        if(std::uniform_real_distribution<float>(0.0f, 1.0f)(rng) >= mutation_crossover_threshold) {
             if(crossover == CROSS_NONE) continue;
 
-            CandidatePair<T> children;
             SolutionPair<T> parents;
             size_t first, second;
-            
-            first = SelectRoulette(subpop);
-            do {
-                second = SelectRoulette(subpop);
-            } while(first != second);
+            std::tie(first, second) = selector.SamplePair(rng);
 
             parents.first   = &subpop[first];
             parents.second  = &subpop[second];
@@ -133,13 +232,13 @@ void Optimizer<T>::ChildStep(subpopulation<T>& subpop) {
             subpop[first].setIsParent(true);
             subpop[second].setIsParent(true);
 
-            children = T::Crossover({*parents.first, *parents.second});
+            CandidatePair<T> children = T::Crossover({parents.first->CloneGenome(), parents.second->CloneGenome()});
             
-            subpop.crossoverFamilyBuffer.push_back({parents, children});
+            subpop.crossoverFamilyBuffer.push_back({parents, std::move(children)});
         } else {
-            int working_index = uniform_int(gen);
+            int working_index = std::uniform_int_distribution<int>(0, subpop.size()-1)(rng);
             Solution<T> working_sol = &subpop[working_index];
-            T new_sol(*working_sol);
+            T new_sol = working_sol->CloneGenome();
 
             switch(mutator){
                 case MUTATE_RANDOM:
@@ -153,28 +252,79 @@ void Optimizer<T>::ChildStep(subpopulation<T>& subpop) {
                     MutateSolution(&new_sol);
                 }
             }
-            AsexualFamily<T> fam{working_sol, new_sol};
-            subpop.mutationFamilyBuffer.push_back(fam);            
+            subpop.mutationFamilyBuffer.push_back({working_sol, std::move(new_sol)});
         }
     }
 
-    //STEP 2: Evaluate Children
+    if(util::trace::Enabled())
+        util::trace::Record("Variation", "optimize", variation_begin, util::trace::Now());
+}
+
+//STEP 2: Evaluate Children
+// The children of every island are built and simulated as one batch, so
+// the simulator sees full batches however many islands there are.
+// Robots are moved between the family buffers and evalBuf, never copied.
+template<typename T>
+void Optimizer<T>::EvaluateChildren(const std::vector<subpopulation<T>*>& islands) {
+    std::vector<T> evalBuf;
+    size_t count = 0;
+    for(subpopulation<T>* subpop : islands) {
+        count += subpop->mutationFamilyBuffer.size() + 2*subpop->crossoverFamilyBuffer.size();
+    }
+    evalBuf.reserve(count);
+
+    for(subpopulation<T>* subpop : islands) {
+        for(AsexualFamily<T>& fam : subpop->mutationFamilyBuffer) {
+            evalBuf.push_back(std::move(fam.child));
+        }
+        for(SexualFamily<T>& fam : subpop->crossoverFamilyBuffer) {
+            evalBuf.push_back(std::move(fam.children.first));
+            evalBuf.push_back(std::move(fam.children.second));
+        }
+    }
+    BuildAndEvaluate(evalBuf);
+
+    size_t k = 0;
+    for(subpopulation<T>* subpop : islands) {
+        for(AsexualFamily<T>& fam : subpop->mutationFamilyBuffer) {
+            fam.child = std::move(evalBuf[k++]);
+        }
+        for(SexualFamily<T>& fam : subpop->crossoverFamilyBuffer) {
+            fam.children.first = std::move(evalBuf[k++]);
+            fam.children.second = std::move(evalBuf[k++]);
+        }
+    }
+}
+
+// Only the pareto front is written, and the elite slots are kept built as
+// well; everything else only needs its genome and fitness until it is a
+// parent or dies.
+template<typename T>
+void Optimizer<T>::ReleaseUnread(subpopulation<T>& subpop) {
+    size_t keep = std::min<size_t>(std::max<size_t>(elitism * subpop.size(), 1), subpop.size());
+    for(auto i = subpop.begin() + keep; i < subpop.end(); i++) {
+        if(i->paretoLayer() > 0) i->ReleasePhenotype();
+    }
+}
+
+// Parent pointers stay valid because every subpopulation slot is refilled
+// before step 3
+template<typename T>
+void Optimizer<T>::ReplaceWithChildren(subpopulation<T>& subpop) {
     std::vector<T> evalBuf;
+    evalBuf.reserve(subpop.mutationFamilyBuffer.size() + 2*subpop.crossoverFamilyBuffer.size() + subpop.size());
 
     for(AsexualFamily<T>& fam : subpop.mutationFamilyBuffer) {
-        evalBuf.push_back(fam.child);
+        evalBuf.push_back(std::move(fam.child));
     }
 
     for(SexualFamily<T>& fam : subpop.crossoverFamilyBuffer) {
-        evalBuf.push_back(fam.children.first);
-        evalBuf.push_back(fam.children.second);
+        evalBuf.push_back(std::move(fam.children.first));
+        evalBuf.push_back(std::move(fam.children.second));
     }
-    T::BatchBuild(evalBuf);
-    Evaluator<T>::BatchEvaluate(evalBuf);
-
 
     for(auto i = subpop.begin(); i < subpop.end(); i++) {
-        evalBuf.push_back(*i);
+        evalBuf.push_back(std::move(*i));
     }
 
     switch(replacement){
@@ -195,16 +345,16 @@ void Optimizer<T>::ChildStep(subpopulation<T>& subpop) {
 
             uint count = 0;
             for(AsexualFamily<T>& fam : subpop.mutationFamilyBuffer) {
-                fam.child = evalBuf[count++];
+                fam.child = std::move(evalBuf[count++]);
             }
 
             for(SexualFamily<T>& fam : subpop.crossoverFamilyBuffer) {
-                fam.children.first = evalBuf[count++];
-                fam.children.second = evalBuf[count++];
+                fam.children.first = std::move(evalBuf[count++]);
+                fam.children.second = std::move(evalBuf[count++]);
             }
 
             for(auto i = subpop.begin(); i < subpop.end(); i++) {
-                *i = evalBuf[count++];
+                *i = std::move(evalBuf[count++]);
             }
 
             //STEP 3: Compare Children to Parents
@@ -229,10 +379,10 @@ void Optimizer<T>::ChildStep(subpopulation<T>& subpop) {
                     case CROSS_DC: 
                     {
                         float D00, D11, D01, D10;
-                        CandidatePair<T> P0 = {fam.children.first, *fam.parents.first},
-                                      P1 = {fam.children.second, *fam.parents.second},
-                                      P2 = {fam.children.first,  *fam.parents.second},
-                                      P3 = {fam.children.second, *fam.parents.first };
+                        CandidatePair<T> P0 = {fam.children.first.CloneGenome(), fam.parents.first->CloneGenome()},
+                                      P1 = {fam.children.second.CloneGenome(), fam.parents.second->CloneGenome()},
+                                      P2 = {fam.children.first.CloneGenome(),  fam.parents.second->CloneGenome()},
+                                      P3 = {fam.children.second.CloneGenome(), fam.parents.first->CloneGenome() };
 
 
                         D00 = T::Distance(P0);
@@ -271,12 +421,264 @@ void Optimizer<T>::ChildStep(subpopulation<T>& subpop) {
         break;
     }
 
+    //STEP 4: Release bodies nobody will read
+    ReleaseUnread(subpop);
+
     subpop.mutationFamilyBuffer.clear();
     subpop.crossoverFamilyBuffer.clear();
 }
 
+// One generation of every island: variation with one thread per island,
+// a single evaluation batch for all children, then replacement with one
+// thread per island again
+template<typename T>
+void Optimizer<T>::IslandStep() {
+    TRACE_SCOPE("IslandStep");
+    std::vector<subpopulation<T>*> islands;
+    for(subpopulation<T>& subpop : subpop_list) islands.push_back(&subpop);
+
+    util::ParallelFor(islands.size(), islands.size(), [&](size_t begin, size_t end) {
+        for(size_t i = begin; i < end; i++) GenerateChildren(*islands[i]);
+    });
+    EvaluateChildren(islands);
+    util::ParallelFor(islands.size(), islands.size(), [&](size_t begin, size_t end) {
+        for(size_t i = begin; i < end; i++) ReplaceWithChildren(*islands[i]);
+    });
+}
+
+// Ring migration. Every island posts copies of its best robots to the next
+// island's admission buffer; once all have posted, each island replaces
+// its worst robots with what it was sent. Islands must be sorted.
+template<typename T>
+void Optimizer<T>::Migrate() {
+    TRACE_SCOPE("Migrate");
+    size_t count = subpop_list.size();
+
+    util::ParallelFor(count, count, [&](size_t begin, size_t end) {
+        for(size_t i = begin; i < end; i++) {
+            subpopulation<T>& source = subpop_list[i];
+            subpopulation<T>& target = subpop_list[(i+1) % count];
+            size_t migrants = std::min<size_t>(migrant_count, source.size());
+            std::lock_guard<std::mutex> lock(target.a_mutex);
+            for(size_t k = 0; k < migrants; k++) {
+                target.admissionBuffer.push(source[k]);
+            }
+        }
+    });
+
+    util::ParallelFor(count, count, [&](size_t begin, size_t end) {
+        for(size_t i = begin; i < end; i++) {
+            subpopulation<T>& island = subpop_list[i];
+            std::lock_guard<std::mutex> lock(island.a_mutex);
+            size_t slot = island.size();
+            while(!island.admissionBuffer.empty() && slot > 0) {
+                island[--slot] = std::move(island.admissionBuffer.front());
+                island.admissionBuffer.pop();
+            }
+            std::queue<T>().swap(island.admissionBuffer);
+            Evaluator<T>::pareto_sort(island.begin(), island.end());
+        }
+    });
+}
+
+// Oldest age allowed in ALPS layer l, on the polynomial scheme
+// age_gap * {1, 2, 4, 9, 16, ...}. The top layer has no limit.
+template<typename T>
+uint Optimizer<T>::AgeLimit(size_t layer) {
+    if(layer+1 >= subpop_list.size()) return UINT_MAX;
+    return age_gap * (layer < 2 ? layer+1 : layer*layer);
+}
+
+// ALPS promotion. Robots older than their layer's limit leave it: they take
+// an emptied slot of the layer above, or its worst robot's slot if they are
+// at least as fit, and are dropped otherwise. Emptied slots are refilled
+// with mutated clones of robots from the layer below (random robots in the
+// bottom layer), and every age_gap generations the whole bottom layer is
+// restarted. All new robots are evaluated in one batch. Layers must be
+// sorted.
+template<typename T>
+void Optimizer<T>::PromoteAgeLayers(ulong generation) {
+    TRACE_SCOPE("PromoteAgeLayers");
+    size_t layers = subpop_list.size();
+    std::vector<std::vector<size_t>> vacated(layers);
+
+    for(size_t l = layers-1; l-- > 0;) {
+        subpopulation<T>& layer = subpop_list[l];
+        subpopulation<T>& next = subpop_list[l+1];
+        uint limit = AgeLimit(l);
+        size_t worst = next.size();
+        for(size_t i = 0; i < layer.size(); i++) {
+            if(layer[i].age() <= limit) continue;
+            if(!vacated[l+1].empty()) {
+                next[vacated[l+1].back()] = std::move(layer[i]);
+                vacated[l+1].pop_back();
+            } else if(worst > 0 && layer[i].fitness() >= next[worst-1].fitness()) {
+                next[--worst] = std::move(layer[i]);
+            }
+            vacated[l].push_back(i);
+        }
+    }
+
+    if(age_gap > 0 && generation % age_gap == 0) {
+        vacated[0].resize(subpop_list[0].size());
+        std::iota(vacated[0].begin(), vacated[0].end(), 0);
+    }
+
+    std::mt19937& rng = selection::ThreadRNG();
+    std::vector<T*> slots;
+    std::vector<T> evalBuf;
+    for(size_t l = layers; l-- > 0;) {
+        std::vector<bool> empty(subpop_list[l].size(), false);
+        for(size_t i : vacated[l]) empty[i] = true;
+        for(size_t i : vacated[l]) {
+            T* parent = nullptr;
+            if(l > 0) {
+                subpopulation<T>& below = subpop_list[l-1];
+                size_t j = std::uniform_int_distribution<size_t>(0, below.size()-1)(rng);
+                if(std::find(vacated[l-1].begin(), vacated[l-1].end(), j) == vacated[l-1].end()) parent = &below[j];
+            }
+            if(parent) {
+                evalBuf.push_back(parent->CloneGenome());
+                MutateSolution(&evalBuf.back());
+            } else {
+                evalBuf.emplace_back();
+                evalBuf.back().Randomize();
+            }
+            slots.push_back(&subpop_list[l][i]);
+        }
+    }
+    if(evalBuf.empty()) return;
+
+    BuildAndEvaluate(evalBuf);
+    for(size_t k = 0; k < slots.size(); k++) {
+        *slots[k] = std::move(evalBuf[k]);
+    }
+}
+
+// Sorts the population and returns the indices of its robots, best first.
+// Islands are sorted within their own ranges and only ranked together
+// through the returned indices, so no robot changes island.
+template<typename T>
+std::vector<uint32_t> Optimizer<T>::RankPopulation(std::vector<T>& population, bool islands) {
+    std::vector<uint32_t> ranking(population.size());
+    std::iota(ranking.begin(), ranking.end(), 0);
+    if(!islands) {
+        Evaluator<T>::pareto_sort(population.begin(), population.end());
+        return ranking;
+    }
+
+    util::ParallelFor(subpop_list.size(), subpop_list.size(), [&](size_t begin, size_t end) {
+        for(size_t i = begin; i < end; i++) {
+            Evaluator<T>::pareto_sort(subpop_list[i].begin(), subpop_list[i].end());
+        }
+    });
+    Evaluator<T>::pareto_classify(population.begin(), population.end());
+    std::stable_sort(ranking.begin(), ranking.end(), [&](uint32_t a, uint32_t b) {
+        return population[a] > population[b];
+    });
+    return ranking;
+}
+
+// Records the histories and prints the readout of one generation (in
+// steady state, of every pop_size evaluations). ranking lists population
+// indices best first. The population is only read, so the steady-state
+// solver can hold its lock over this and write the files afterwards.
 template<typename T>
-std::vector<T> Optimizer<T>::NoNicheSolve() {
+void Optimizer<T>::ReportGeneration(ulong generation, std::vector<T>& population, const std::vector<uint32_t>& ranking,
+        float seconds, ulong evaluations) {
+    auto ranked = [&](size_t r) -> T& { return population[ranking[r]]; };
+    std::vector<float> diversity = T::findDiversity(population);
+
+    uint archived = 0;
+    uint i = 1;
+    while (i+1 < population.size() && ranked(i) <= ranked(i+1))
+    {
+        if(ranked(archived).fitness() < ranked(i).fitness())
+            archived = i;
+        i++;
+    }
+
+    solution_history.push_back({Evaluator<T>::eval_count, ranked(archived).CloneGenome()});
+    fitness_history.push_back({Evaluator<T>::eval_count, ranked(archived).fitness()});
+
+    printf("Generation: %lu, Evlauation: %lu\t%s\n",
+        generation,
+        Evaluator<T>::eval_count,
+        ranked(0).fitnessReadout().data());
+    printf("----PARETO SOLUTIONS----\n");
+    
+    i = 0;
+    pareto_solutions.clear();
+    while(i < population.size()) {
+        if(ranked(i).paretoLayer() > 0) break;
+        pareto_solutions.push_back(ranked(i));
+        printf("%u:\t%s\n",
+            i,
+            ranked(i).fitnessReadout().data());
+        i++;
+    }
+    uint valid = 0;
+    uint invalid = 0;
+    for(const Candidate& c : population) {
+        if(c.isValid()) valid++;
+        else invalid++;
+    }
+    printf("Valid: %u,\tInvalid: %u\n",valid,invalid);
+    if(niche == NICHE_ALPS && subpop_list.size() > 1) {
+        printf("Layer ages (max/limit):");
+        for(size_t l = 0; l < subpop_list.size(); l++) {
+            uint oldest = 0;
+            for(auto r = subpop_list[l].begin(); r < subpop_list[l].end(); r++) oldest = std::max(oldest, r->age());
+            if(AgeLimit(l) == UINT_MAX) printf(" %u/-", oldest);
+            else printf(" %u/%u", oldest, AgeLimit(l));
+        }
+        printf("\n");
+    }
+    printf("Generation time: %f s\n", seconds);
+    printf("Evaluations/s: %.1f\n", seconds > 0.0f ? evaluations / seconds : 0.0f);
+    printf("Peak RSS: %.1f MB\n", util::PeakRSS() / (1024.0f * 1024.0f));
+    printf("Rejected: %lu/%lu built robots\n",rejected_count,built_count);
+    rejected_count = 0;
+    built_count = 0;
+    printf("Simulator: %s\n", Evaluator<T>::Sim.Stats().ToString().data());
+    printf("Cache: phenotype %lu/%lu hits (%.1f%%), fitness %lu/%lu hits (%.1f%%)\n",
+        phenotype_cache.hits(), phenotype_cache.hits() + phenotype_cache.misses(), 100.0f * phenotype_cache.hitRate(),
+        fitness_cache.hits(), fitness_cache.hits() + fitness_cache.misses(), 100.0f * fitness_cache.hitRate());
+    phenotype_cache.resetStats();
+    fitness_cache.resetStats();
+    Evaluator<T>::Sim.ResetStats();
+    if(util::perf::Enabled()) {
+        printf("%s", util::perf::Report().data());
+        util::perf::Reset();
+    }
+    printf("----------------------\n");
+
+    if(generation % config.optimizer.save_skip == 0 || eval_count > max_evals) {
+        diversity_history.push_back({Evaluator<T>::eval_count, diversity[0]});
+        std::vector<float> generation_history(population.size());
+        for(i = 0; i < population.size(); i++)
+            generation_history[i] = ranked(i).fitness();
+        population_history.push_back({Evaluator<T>::eval_count, generation_history, diversity});
+    }
+}
+
+// Writes the pareto front collected by the last report. Only those copies
+// are touched, never the population.
+template<typename T>
+void Optimizer<T>::SaveGeneration(ulong generation) {
+    if(generation % config.optimizer.save_skip != 0 && eval_count <= max_evals) return;
+
+    float best_fitness = -1000.0f;
+    for(const T& R : pareto_solutions) {
+        if(R.fitness() > best_fitness) best_fitness = R.fitness();
+    }
+    std::string gen_directory = working_directory + "/generation_" + std::to_string(generation) + "_fitness_" + std::to_string(best_fitness);
+    MaterializePhenotypes(pareto_solutions.begin(), pareto_solutions.end());
+    WriteSolutions(pareto_solutions,gen_directory);
+}
+
+template<typename T>
+std::vector<T> Optimizer<T>::GenerationalSolve() {
     subpop_size = pop_size/niche_count;
     
     std::vector<std::thread*> threads(niche_count);
@@ -293,25 +695,44 @@ std::vector<T> Optimizer<T>::NoNicheSolve() {
     } else {
         for(uint i = 0; i < niche_count; i++) {
             auto begin = population.begin() + i*subpop_size;
-            auto end = begin + subpop_size;
+            // the last island takes the remainder
+            auto end = (i == niche_count-1) ? population.end() : begin + subpop_size;
             subpop_list[i] = subpopulation<T>(begin, end);
         }
     }
+    // ALPS layers are islands that exchange robots by age instead of
+    // by migration
+    bool alps = niche == NICHE_ALPS && niche_count > 1;
+    bool islands = (niche == NICHE_ISLAND || alps) && niche_count > 1;
+    if(alps) {
+        printf("ALPS: %u layers, age limits", niche_count);
+        for(uint l = 0; l+1 < niche_count; l++) printf(" %u", AgeLimit(l));
+        printf(" and unbounded\n");
+    } else if(islands) {
+        printf("Islands: %u, migrating %u robots every %u generations\n", niche_count, migrant_count, exchange_steps);
+    }
 
     RandomizePopulation(population);
-    Evaluator<T>::pareto_sort(population.begin(),population.end());
-    printf("Initial Best: %f\n",population[0].fitness());
+    std::vector<uint32_t> ranking = RankPopulation(population, islands);
+    auto ranked = [&](size_t r) -> T& { return population[ranking[r]]; };
+    printf("Initial Best: %f\n",ranked(0).fitness());
 
     ulong generation = 1;
     std::vector<float>generation_history(population.size());
     for(size_t i = 0; i < population.size(); i++)
-        generation_history[i] = population[i].fitness();
+        generation_history[i] = ranked(i).fitness();
     std::vector<float> diversity = T::findDiversity(population);
 
     population_history.push_back({Evaluator<T>::eval_count, generation_history, diversity});
+    generation_times.clear();
+    generation_evaluations.clear();
     while(Evaluator<T>::eval_count < max_evals) {
+        TRACE_SCOPE("Generation");
+        auto generation_start = std::chrono::steady_clock::now();
+        ulong generation_evals = Evaluator<T>::eval_count;
 
-        ChildStep(full_pop);
+        if(islands) IslandStep();
+        else ChildStep(full_pop);
 
         for(uint i = 0; i < population.size(); i++) {
             if(full_pop[i].isParent()){
@@ -319,68 +740,190 @@ std::vector<T> Optimizer<T>::NoNicheSolve() {
                 full_pop[i].setIsParent(false);
             }
         }
-        Evaluator<T>::pareto_sort(population.begin(),population.end());
+        ranking = RankPopulation(population, islands);
+
+        if(alps) {
+            PromoteAgeLayers(generation);
+            ranking = RankPopulation(population, islands);
+        } else if(islands && exchange_steps > 0 && generation % exchange_steps == 0) {
+            Migrate();
+            ranking = RankPopulation(population, islands);
+        }
 
-        if(generation % injection_rate == 0){
-            RandomizeSolution(&population[population.size()-1]);
-            Evaluator<T>::pareto_sort(population.begin(),population.end());
+        if(!alps && generation % injection_rate == 0){
+            RandomizeSolution(&ranked(population.size()-1));
+            ranking = RankPopulation(population, islands);
         }
-        diversity = T::findDiversity(population);
+        generation_times.push_back(std::chrono::duration<float>(std::chrono::steady_clock::now() - generation_start).count());
+        generation_evaluations.push_back(Evaluator<T>::eval_count - generation_evals);
+        ReportGeneration(generation, population, ranking, generation_times.back(), generation_evaluations.back());
+        SaveGeneration(generation);
+        generation++;
+    }
 
-        T archived_solution;
-        archived_solution = population[0];
-        uint i = 1;
-        while (population[i] <= population[i+1] && i < population.size())
-        {
-            if(archived_solution.fitness() < population[i].fitness())
-                archived_solution = population[i];
-            i++;
+    ranking = RankPopulation(population, islands);
+
+    solutions.clear();
+    solutions.push_back(ranked(0));
+    uint i = 1;
+    while(i < pop_size) {
+        if(ranked(i).paretoLayer() > 0) break;
+        solutions.push_back(ranked(i));
+        i++;
+    }
+    MaterializePhenotypes(solutions.begin(), solutions.end());
+    return solutions;
+}
+
+// Called with subpop.p_mutex held. Parents drawn since the last batch age
+// by one, then the batch competes with the whole population and the best
+// subpop.size() robots of both survive, in pareto order.
+template<typename T>
+void Optimizer<T>::SteadyStateReplace(subpopulation<T>& subpop, std::vector<T>& children) {
+    std::vector<T> evalBuf;
+    evalBuf.reserve(subpop.size() + children.size());
+    for(auto i = subpop.begin(); i < subpop.end(); i++) {
+        if(i->isParent()) {
+            i->IncrementAge();
+            i->setIsParent(false);
         }
+        evalBuf.push_back(std::move(*i));
+    }
+    for(T& child : children) {
+        evalBuf.push_back(std::move(child));
+    }
+    children.clear();
 
-        solution_history.push_back({Evaluator<T>::eval_count, archived_solution});
-        fitness_history.push_back({Evaluator<T>::eval_count, archived_solution.fitness()});
+    Evaluator<T>::pareto_sort(evalBuf.begin(), evalBuf.end());
+    uint count = 0;
+    for(auto i = subpop.begin(); i < subpop.end(); i++) {
+        *i = std::move(evalBuf[count++]);
+    }
+    ReleaseUnread(subpop);
+}
 
-        printf("Generation: %lu, Evlauation: %lu\t%s\n",
-            generation,
-            Evaluator<T>::eval_count,
-            population[0].fitnessReadout().data());
-        printf("----PARETO SOLUTIONS----\n");
-        
-        i = 0;
-        T sol;
-        pareto_solutions.clear();
-        float best_fitness = -1000.0f;
-        while(i < pop_size) {
-            if(population[i].paretoLayer() > 0) break;
-            sol = population[i];
-            pareto_solutions.push_back(sol);
-            if(sol.fitness() > best_fitness) best_fitness = sol.fitness();
-            printf("%u:\t%s\n",
-                i,
-                population[i].fitnessReadout().data());
-            i++;
+template<typename T>
+void Optimizer<T>::SteadyStateMutate(T& child) {
+    switch(mutator){
+        case MUTATE_RANDOM:
+            RandomizeSolution(&child);
+            break;
+        case MUTATE:
+        default:
+            MutateSolution(&child);
+    }
+}
+
+// One producer iteration: parents are drawn and cloned under the
+// population lock, the children are bred outside it and queued. Returns
+// false once the queue is closed.
+template<typename T>
+bool Optimizer<T>::SteadyStateStep(subpopulation<T>& subpop, const selection::Selector& selector, util::BoundedQueue<T>& queue) {
+    std::mt19937& rng = selection::ThreadRNG();
+    bool cross = crossover != CROSS_NONE &&
+        std::uniform_real_distribution<float>(0.0f, 1.0f)(rng) >= mutation_crossover_threshold;
+
+    // clones are built in place, a default robot would draw random genes
+    std::vector<T> genomes;
+    genomes.reserve(2);
+    {
+        std::lock_guard<std::mutex> lock(subpop.p_mutex);
+        if(cross) {
+            size_t first, second;
+            std::tie(first, second) = selector.SamplePair(rng);
+            subpop[first].setIsParent(true);
+            subpop[second].setIsParent(true);
+            genomes.push_back(subpop[first].CloneGenome());
+            genomes.push_back(subpop[second].CloneGenome());
+        } else {
+            int working_index = std::uniform_int_distribution<int>(0, subpop.size()-1)(rng);
+            subpop[working_index].setIsParent(true);
+            genomes.push_back(subpop[working_index].CloneGenome());
         }
-        uint valid = 0;
-        uint invalid = 0;
-        for(const Candidate& c : population) {
-            if(c.isValid()) valid++;
-            else invalid++;
+    }
+
+    if(cross) {
+        CandidatePair<T> children = T::Crossover({std::move(genomes[0]), std::move(genomes[1])});
+        return queue.Push(std::move(children.first)) && queue.Push(std::move(children.second));
+    }
+    SteadyStateMutate(genomes[0]);
+    return queue.Push(std::move(genomes[0]));
+}
+
+// Evolution without a generation barrier. producer_count threads breed
+// children from the current population into a bounded queue while this
+// thread evaluates them eval_batch at a time, so breeding the next batch
+// overlaps evaluating this one. Each batch replaces the worst robots as
+// soon as its fitness is known, and the work per batch does not grow with
+// the population beyond one pareto sort.
+template<typename T>
+std::vector<T> Optimizer<T>::SteadyStateSolve() {
+    std::vector<T> population(pop_size);
+    subpopulation<T> full_pop(population.begin(), population.end());
+    subpop_list.clear();
+
+    uint batch_size = std::max(eval_batch, 1u);
+    uint producers = std::max(producer_count, 1u);
+    printf("Steady state: %u producers, evaluation batches of %u\n", producers, batch_size);
+
+    RandomizePopulation(population);
+    Evaluator<T>::pareto_sort(population.begin(), population.end());
+    printf("Initial Best: %f\n",population[0].fitness());
+
+    // the population is kept in pareto order, so ranks are its indices
+    std::vector<uint32_t> ranking(population.size());
+    std::iota(ranking.begin(), ranking.end(), 0);
+    std::vector<float>generation_history(population.size());
+    for(size_t i = 0; i < population.size(); i++)
+        generation_history[i] = population[i].fitness();
+    population_history.push_back({Evaluator<T>::eval_count, generation_history, T::findDiversity(population)});
+
+    selection::Selector selector(selection, tournament_size);
+    std::vector<float> fitness(population.size());
+    auto prepareSelector = [&]() {
+        for(size_t i = 0; i < population.size(); i++) fitness[i] = population[i].fitness();
+        selector.Prepare(fitness);
+    };
+    prepareSelector();
+
+    // room for the batch being bred while the previous one is evaluated
+    util::BoundedQueue<T> queue(2 * batch_size);
+    std::vector<std::thread> threads;
+    for(uint i = 0; i < producers; i++) {
+        threads.emplace_back([&]() {
+            while(SteadyStateStep(full_pop, selector, queue));
+        });
+    }
+
+    ulong generation = 1;
+    ulong report_evals = Evaluator<T>::eval_count;
+    auto report_start = std::chrono::steady_clock::now();
+    std::vector<T> batch;
+    batch.reserve(batch_size);
+    while(Evaluator<T>::eval_count < max_evals) {
+        TRACE_SCOPE("SteadyStateBatch");
+        if(queue.PopBatch(batch, batch_size) == 0) break;
+        BuildAndEvaluate(batch);
+        {
+            std::lock_guard<std::mutex> lock(full_pop.p_mutex);
+            SteadyStateReplace(full_pop, batch);
+            prepareSelector();
         }
-        printf("Valid: %u,\tInvalid: %u\n",valid,invalid);
-        printf("----------------------\n");
-
-        std::string gen_directory = working_directory + "/generation_" + std::to_string(generation) + "_fitness_" + std::to_string(best_fitness);
-        if(generation % config.optimizer.save_skip == 0 || eval_count > max_evals) {
-            WriteSolutions(pareto_solutions,gen_directory);
-            diversity_history.push_back({Evaluator<T>::eval_count, diversity[0]});
-            for(i = 0; i < population.size(); i++)
-                generation_history[i] = population[i].fitness();
-            population_history.push_back({Evaluator<T>::eval_count, generation_history, diversity});
+
+        if(Evaluator<T>::eval_count - report_evals < population.size()) continue;
+        {
+            std::lock_guard<std::mutex> lock(full_pop.p_mutex);
+            ReportGeneration(generation, population, ranking,
+                std::chrono::duration<float>(std::chrono::steady_clock::now() - report_start).count(),
+                Evaluator<T>::eval_count - report_evals);
         }
+        SaveGeneration(generation);
         generation++;
+        report_evals = Evaluator<T>::eval_count;
+        report_start = std::chrono::steady_clock::now();
     }
-
-    Evaluator<T>::pareto_sort(population.begin(),population.end());
+    queue.Close();
+    for(std::thread& t : threads) t.join();
 
     solutions.clear();
     solutions.push_back(population[0]);
@@ -390,6 +933,7 @@ std::vector<T> Optimizer<T>::NoNicheSolve() {
         solutions.push_back(population[i]);
         i++;
     }
+    MaterializePhenotypes(solutions.begin(), solutions.end());
     return solutions;
 }
 
@@ -405,25 +949,41 @@ std::vector<T> Optimizer<T>::Solve(OptimizerConfig config) {
     mutator = opt_config.mutation;
     crossover = opt_config.crossover;
     replacement = opt_config.replacement;
+    selection = opt_config.selection;
+    tournament_size = opt_config.tournament_size;
     niche = opt_config.niche;
+    migrant_count = opt_config.migrant_count;
+    age_gap = opt_config.age_gap;
+    evolution = opt_config.evolution;
+    eval_batch = opt_config.eval_batch;
+    producer_count = opt_config.producer_count;
 
     uniform_int = std::uniform_int_distribution<>(0,pop_size-1);
 
 
     elitism = opt_config.elitism;
 
+    phenotype_cache.setCapacity(opt_config.phenotype_cache_size);
+    fitness_cache.setCapacity(opt_config.fitness_cache_size);
+
+    util::trace::Enable(config.io.trace_file != "");
+
     for(int N = 0; N < opt_config.repeats; N++) {
         printf("Started Run %i\n",N);
 
 		working_directory = std::string(config.io.out_dir) + std::string("/run_") + std::to_string(N);
         util::MakeDirectory(working_directory);
 
-        switch(niche){
+        if(evolution == EVOLVE_STEADY_STATE) {
+            solutions = SteadyStateSolve();
+        } else switch(niche){
             case NICHE_NONE:
-                solutions = NoNicheSolve();
+            case NICHE_ISLAND:
+            case NICHE_ALPS:
+                solutions = GenerationalSolve();
                 break;
             default:
-                solutions = NoNicheSolve();
+                solutions = GenerationalSolve();
                 break;
         }
 
@@ -440,6 +1000,11 @@ std::vector<T> Optimizer<T>::Solve(OptimizerConfig config) {
 		util::WriteCSV(solution_fitness_filename, working_directory, fitnessHistoryCSV);
 		util::WriteCSV(population_fitness_filename, working_directory, popFitHistoryCSV);
 		util::WriteCSV(population_diversity_filename, working_directory, popDivHistoryCSV);
+
+		if(util::trace::Enabled()) {
+			util::trace::WriteChromeTrace(config.io.trace_file, working_directory);
+			util::trace::Clear();
+		}
         
 		printf("Run %i Success\n", N);
 		reset();
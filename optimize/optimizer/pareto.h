@@ -0,0 +1,92 @@
+#ifndef __PARETO_H__
+#define __PARETO_H__
+
+#include <algorithm>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+// Non-dominated sorting over a compact objective array: row i holds the
+// dims objectives of point i, all maximized. A point dominates another
+// when it is at least as good in every objective and better in one.
+// Layer 0 is the non-dominated front, layer k is the front of what is left
+// after removing layers 0..k-1.
+namespace pareto {
+
+    inline bool Dominates(const float* a, const float* b, size_t dims) {
+        bool better = false;
+        for(size_t d = 0; d < dims; d++) {
+            if(a[d] < b[d]) return false;
+            if(a[d] > b[d]) better = true;
+        }
+        return better;
+    }
+
+    // Two objectives in O(n log n). Points are swept in order of the first
+    // objective (ties by the second), so every dominator of a point comes
+    // before it. Within a front the swept points get worse in the second
+    // objective, so the last point of a front dominates a new point
+    // whenever any of its members does, and those last points get worse
+    // front by front: the new point's layer is found by binary search.
+    inline void Classify2D(const float* obj, size_t count, uint* layers) {
+        std::vector<uint32_t> order(count);
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [obj](uint32_t a, uint32_t b) {
+            if(obj[2*a] != obj[2*b]) return obj[2*a] > obj[2*b];
+            return obj[2*a+1] > obj[2*b+1];
+        });
+
+        std::vector<uint32_t> last; // last point swept into each front
+        for(uint32_t p : order) {
+            auto front = std::partition_point(last.begin(), last.end(), [&](uint32_t q) {
+                return Dominates(&obj[2*q], &obj[2*p], 2);
+            });
+            layers[p] = front - last.begin();
+            if(front == last.end()) last.push_back(p);
+            else *front = p;
+        }
+    }
+
+    // Any number of objectives in O(dims n^2) (Deb et al., NSGA-II)
+    inline void ClassifyGeneral(const float* obj, size_t count, size_t dims, uint* layers) {
+        std::vector<std::vector<uint32_t>> dominated(count); // points each point dominates
+        std::vector<uint32_t> dominators(count, 0);
+        for(size_t i = 0; i < count; i++) {
+            for(size_t j = i+1; j < count; j++) {
+                if(Dominates(&obj[dims*i], &obj[dims*j], dims)) {
+                    dominated[i].push_back(j);
+                    dominators[j]++;
+                } else if(Dominates(&obj[dims*j], &obj[dims*i], dims)) {
+                    dominated[j].push_back(i);
+                    dominators[i]++;
+                }
+            }
+        }
+
+        std::vector<uint32_t> front, next;
+        for(size_t i = 0; i < count; i++) {
+            if(dominators[i] == 0) front.push_back(i);
+        }
+        for(uint layer = 0; !front.empty(); layer++) {
+            next.clear();
+            for(uint32_t i : front) {
+                layers[i] = layer;
+                for(uint32_t j : dominated[i]) {
+                    if(--dominators[j] == 0) next.push_back(j);
+                }
+            }
+            std::swap(front, next);
+        }
+    }
+
+    // objectives holds count * dims values, layers receives one per point
+    inline void Classify(const std::vector<float>& objectives, size_t dims, std::vector<uint>& layers) {
+        size_t count = dims > 0 ? objectives.size() / dims : 0;
+        layers.resize(count);
+        if(count == 0) return;
+        if(dims == 2) Classify2D(objectives.data(), count, layers.data());
+        else ClassifyGeneral(objectives.data(), count, dims, layers.data());
+    }
+}
+
+#endif
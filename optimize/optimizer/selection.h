@@ -0,0 +1,155 @@
+#ifndef __SELECTION_H__
+#define __SELECTION_H__
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <numeric>
+#include <random>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "optimizer_config.h"
+
+// Parent selection over a compact fitness array. Prepare runs once per
+// generation; every draw after that is O(1) (O(k) for tournaments) and
+// reads only the selector, never the robots.
+namespace selection {
+
+    // Generator owned by the calling thread, so workers can draw parents
+    // without sharing state
+    inline std::mt19937& ThreadRNG() {
+        thread_local std::mt19937 rng(std::random_device{}() ^
+            (uint32_t) std::hash<std::thread::id>()(std::this_thread::get_id()));
+        return rng;
+    }
+
+    // Walker's alias method (Vose's construction): index i is drawn with
+    // probability weights[i] / sum(weights) from one uniform slot and one
+    // biased coin.
+    class AliasTable {
+        std::vector<float> mProb;
+        std::vector<uint32_t> mAlias;
+
+    public:
+        // Negative weights count as 0, all zero weights draw uniformly
+        void Build(const float* weights, size_t count) {
+            mProb.assign(count, 1.0f);
+            mAlias.resize(count);
+            std::iota(mAlias.begin(), mAlias.end(), 0);
+            if(count == 0) return;
+
+            double total = 0.0;
+            for(size_t i = 0; i < count; i++) total += std::max(weights[i], 0.0f);
+            if(total <= 0.0) return;
+
+            std::vector<double> scaled(count);
+            std::vector<uint32_t> small, large;
+            for(size_t i = 0; i < count; i++) {
+                scaled[i] = std::max(weights[i], 0.0f) * count / total;
+                if(scaled[i] < 1.0) small.push_back(i);
+                else large.push_back(i);
+            }
+            while(!small.empty() && !large.empty()) {
+                uint32_t s = small.back(), l = large.back();
+                small.pop_back();
+                mProb[s] = scaled[s];
+                mAlias[s] = l;
+                scaled[l] -= 1.0 - scaled[s];
+                if(scaled[l] < 1.0) {
+                    large.pop_back();
+                    small.push_back(l);
+                }
+            }
+            // leftovers are 1 up to rounding
+            for(uint32_t i : small) mProb[i] = 1.0f;
+            for(uint32_t i : large) mProb[i] = 1.0f;
+        }
+
+        template<typename RNG>
+        size_t Sample(RNG& rng) const {
+            size_t i = std::uniform_int_distribution<size_t>(0, mProb.size()-1)(rng);
+            return std::uniform_real_distribution<float>(0.0f, 1.0f)(rng) < mProb[i] ? i : mAlias[i];
+        }
+
+        size_t size() const { return mProb.size(); }
+    };
+
+    class Selector {
+        SelectionStrat mStrategy;
+        uint mTournamentSize;
+        std::vector<float> mFitness;
+        AliasTable mTable;
+
+    public:
+        Selector(SelectionStrat strategy = SELECT_ROULETTE, uint tournament_size = 4) :
+            mStrategy(strategy), mTournamentSize(std::max(tournament_size, 1u)) {}
+
+        // Roulette draws proportionally to fitness (shifted up when some
+        // fitness is negative), rank draws proportionally to n - rank, and
+        // tournaments keep the fitness to compare against
+        void Prepare(const std::vector<float>& fitness) {
+            mFitness = fitness;
+            size_t count = fitness.size();
+            switch(mStrategy) {
+                case SELECT_TOURNAMENT:
+                    break;
+                case SELECT_RANK:
+                {
+                    std::vector<uint32_t> order(count);
+                    std::iota(order.begin(), order.end(), 0);
+                    std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+                        return fitness[a] > fitness[b];
+                    });
+                    std::vector<float> weights(count);
+                    for(size_t r = 0; r < count; r++) weights[order[r]] = count - r;
+                    mTable.Build(weights.data(), count);
+                }
+                break;
+                case SELECT_ROULETTE:
+                default:
+                {
+                    float lo = count > 0 ? *std::min_element(fitness.begin(), fitness.end()) : 0.0f;
+                    std::vector<float> weights(fitness);
+                    if(lo < 0.0f) {
+                        for(float& w : weights) w -= lo;
+                    }
+                    mTable.Build(weights.data(), count);
+                }
+            }
+        }
+
+        template<typename RNG>
+        size_t Sample(RNG& rng) const {
+            if(mStrategy != SELECT_TOURNAMENT) return mTable.Sample(rng);
+
+            std::uniform_int_distribution<size_t> pick(0, mFitness.size()-1);
+            size_t best = pick(rng);
+            for(uint k = 1; k < mTournamentSize; k++) {
+                size_t i = pick(rng);
+                if(mFitness[i] > mFitness[best]) best = i;
+            }
+            return best;
+        }
+
+        // Two different indices whenever there are two to choose from. If
+        // the distribution keeps returning the first pick, the second is
+        // drawn uniformly from the rest.
+        template<typename RNG>
+        std::pair<size_t, size_t> SamplePair(RNG& rng) const {
+            size_t first = Sample(rng);
+            if(mFitness.size() < 2) return {first, first};
+            for(int attempt = 0; attempt < 8; attempt++) {
+                size_t second = Sample(rng);
+                if(second != first) return {first, second};
+            }
+            size_t offset = std::uniform_int_distribution<size_t>(1, mFitness.size()-1)(rng);
+            return {first, (first + offset) % mFitness.size()};
+        }
+
+        size_t size() const { return mFitness.size(); }
+    };
+}
+
+#endif
@@ -23,6 +23,12 @@ enum CrossoverStrat {
 	CROSS_DC = 2
 };
 
+enum SelectionStrat {
+	SELECT_ROULETTE = 0,
+	SELECT_TOURNAMENT = 1,
+	SELECT_RANK = 2
+};
+
 enum ReplacementStrat {
 	REPLACE_STANDARD = 0,
 	PARETO = 1
@@ -31,7 +37,13 @@ enum ReplacementStrat {
 enum NichingStrat {
 	NICHE_NONE = 0,
 	NICHE_HFC = 1,
-	NICHE_ALPS = 2
+	NICHE_ALPS = 2,
+	NICHE_ISLAND = 3
+};
+
+enum EvolutionStrat {
+	EVOLVE_GENERATIONAL = 0,
+	EVOLVE_STEADY_STATE = 1
 };
 
 struct OptimizerConfig : public Config {
@@ -46,15 +58,32 @@ struct OptimizerConfig : public Config {
 		MutationStrat mutation = MUTATE;
 		CrossoverStrat crossover = CROSS_SWAP;
 		ReplacementStrat replacement = PARETO;
+		SelectionStrat selection = SELECT_ROULETTE;
+		int tournament_size = 4;
 		NichingStrat niche = NICHE_NONE;
+		int migrant_count = 2;				// robots each island sends per exchange
+		int age_gap = 5;					// ALPS age limit unit, also the bottom layer restart period
+		EvolutionStrat evolution = EVOLVE_GENERATIONAL;
+		int eval_batch = 64;				// steady state: children per evaluation batch
+		int producer_count = 2;				// steady state: threads generating children
 		float mutation_rate=0.6f;
 		float crossover_rate=0.7f;
 		float elitism=0.1f;
+		int phenotype_cache_size = 128;		// built robots kept by genome hash, 0 disables
+		int fitness_cache_size = 4096;		// fitness values kept by genome hash, 0 disables; ignored when devo_cycles > 0
 	} optimizer;
 	struct Evaluator {
 		int pop_size = 512;
 		float base_time = 0.0;
 		float eval_time = 10.0;
+		int rungs = 1;						// successive halving rungs, 1 simulates everyone for eval_time
+		float rung_keep = 0.5f;				// fraction of a rung that continues to the next
+		bool gait_stop = false;				// stop robots once their gait repeats every actuation period
+		float gait_tolerance = 0.01f;		// largest period to period change, relative to body length
+		bool settle = false;				// end the baseline of each robot once it has settled
+		float settle_energy = 1e-3f;		// kinetic energy per unit mass below which a robot is still
+		float settle_strain = 0.01f;		// mean relative length error of passive springs
+		float settle_window = 0.25f;		// seconds a robot has to stay below both
 	} evaluator;
 
 	OptimizerConfig() {}
@@ -149,11 +149,29 @@ OptimizerConfig optimizer::ReadConfigFile(const std::string& filename) {
         }
     }
 
+    if(config_map.find("SELECTION") != config_map.end()) {
+        if(config_map["SELECTION"] == "roulette") {
+            config.optimizer.selection = SELECT_ROULETTE;
+        } else if(config_map["SELECTION"] == "tournament") {
+            config.optimizer.selection = SELECT_TOURNAMENT;
+        } else if(config_map["SELECTION"] == "rank") {
+            config.optimizer.selection = SELECT_RANK;
+        } else {
+            std::cerr << "Selection type " << config_map["SELECTION"] << " not supported" << std::endl;
+        }
+    }
+
+    if(config_map.find("TOURNAMENT_SIZE") != config_map.end()) {
+        config.optimizer.tournament_size = stoi(config_map["TOURNAMENT_SIZE"]);
+    }
+
     if(config_map.find("NICHE") != config_map.end()) {
         if(config_map["NICHE"] == "alps") {
             config.optimizer.niche = NICHE_ALPS;
         } else if(config_map["NICHE"] == "hfc") {
             config.optimizer.niche = NICHE_HFC;
+        } else if(config_map["NICHE"] == "island") {
+            config.optimizer.niche = NICHE_ISLAND;
         } else if(config_map["NICHE"] == "none") {
             config.optimizer.niche = NICHE_NONE;
         } else {
@@ -161,6 +179,32 @@ OptimizerConfig optimizer::ReadConfigFile(const std::string& filename) {
         }
     }
 
+    if(config_map.find("MIGRANT_COUNT") != config_map.end()) {
+        config.optimizer.migrant_count = stoi(config_map["MIGRANT_COUNT"]);
+    }
+
+    if(config_map.find("AGE_GAP") != config_map.end()) {
+        config.optimizer.age_gap = stoi(config_map["AGE_GAP"]);
+    }
+
+    if(config_map.find("EVOLUTION") != config_map.end()) {
+        if(config_map["EVOLUTION"] == "generational") {
+            config.optimizer.evolution = EVOLVE_GENERATIONAL;
+        } else if(config_map["EVOLUTION"] == "steady_state") {
+            config.optimizer.evolution = EVOLVE_STEADY_STATE;
+        } else {
+            std::cerr << "Evolution type " << config_map["EVOLUTION"] << " not supported" << std::endl;
+        }
+    }
+
+    if(config_map.find("EVAL_BATCH") != config_map.end()) {
+        config.optimizer.eval_batch = stoi(config_map["EVAL_BATCH"]);
+    }
+
+    if(config_map.find("PRODUCERS") != config_map.end()) {
+        config.optimizer.producer_count = stoi(config_map["PRODUCERS"]);
+    }
+
     if(config_map.find("MUTATION_RATE") != config_map.end()) {
         config.optimizer.mutation_rate = stof(config_map["MUTATION_RATE"]);
     }
@@ -173,6 +217,14 @@ OptimizerConfig optimizer::ReadConfigFile(const std::string& filename) {
         config.optimizer.elitism = stof(config_map["ELITISM"]);
     }
 
+    if(config_map.find("PHENOTYPE_CACHE_SIZE") != config_map.end()) {
+        config.optimizer.phenotype_cache_size = stoi(config_map["PHENOTYPE_CACHE_SIZE"]);
+    }
+
+    if(config_map.find("FITNESS_CACHE_SIZE") != config_map.end()) {
+        config.optimizer.fitness_cache_size = stoi(config_map["FITNESS_CACHE_SIZE"]);
+    }
+
     if(config_map.find("BASE_TIME") != config_map.end()) {
         config.evaluator.base_time = stof(config_map["BASE_TIME"]);
     }
@@ -181,6 +233,38 @@ OptimizerConfig optimizer::ReadConfigFile(const std::string& filename) {
         config.evaluator.eval_time = stof(config_map["EVAL_TIME"]);
     }
 
+    if(config_map.find("EVAL_RUNGS") != config_map.end()) {
+        config.evaluator.rungs = stoi(config_map["EVAL_RUNGS"]);
+    }
+
+    if(config_map.find("RUNG_KEEP") != config_map.end()) {
+        config.evaluator.rung_keep = stof(config_map["RUNG_KEEP"]);
+    }
+
+    if(config_map.find("GAIT_STOP") != config_map.end()) {
+        config.evaluator.gait_stop = config_map["GAIT_STOP"] == "true" || config_map["GAIT_STOP"] == "1";
+    }
+
+    if(config_map.find("GAIT_TOLERANCE") != config_map.end()) {
+        config.evaluator.gait_tolerance = stof(config_map["GAIT_TOLERANCE"]);
+    }
+
+    if(config_map.find("SETTLE") != config_map.end()) {
+        config.evaluator.settle = config_map["SETTLE"] == "true" || config_map["SETTLE"] == "1";
+    }
+
+    if(config_map.find("SETTLE_ENERGY") != config_map.end()) {
+        config.evaluator.settle_energy = stof(config_map["SETTLE_ENERGY"]);
+    }
+
+    if(config_map.find("SETTLE_STRAIN") != config_map.end()) {
+        config.evaluator.settle_strain = stof(config_map["SETTLE_STRAIN"]);
+    }
+
+    if(config_map.find("SETTLE_WINDOW") != config_map.end()) {
+        config.evaluator.settle_window = stof(config_map["SETTLE_WINDOW"]);
+    }
+
     return config;
 }
 
@@ -30,5 +30,68 @@ int main(int argc, char** argv)
         std::cout << "Test Case 1: Passed" << std::endl;
     }
 
+	err = TestCache();
+    if(err) {
+        std::cout << "Test Case 2: Failed with " << err << std::endl;
+    } else {
+        std::cout << "Test Case 2: Passed" << std::endl;
+    }
+
+	err = TestPareto();
+    if(err) {
+        std::cout << "Test Case 3: Failed with " << err << std::endl;
+    } else {
+        std::cout << "Test Case 3: Passed" << std::endl;
+    }
+
+	err = TestSelection();
+    if(err) {
+        std::cout << "Test Case 4: Failed with " << err << std::endl;
+    } else {
+        std::cout << "Test Case 4: Passed" << std::endl;
+    }
+
+	err = TestBoundedQueue();
+    if(err) {
+        std::cout << "Test Case 5: Failed with " << err << std::endl;
+    } else {
+        std::cout << "Test Case 5: Passed" << std::endl;
+    }
+
+	err = TestSuccessiveHalving();
+    if(err) {
+        std::cout << "Test Case 6: Failed with " << err << std::endl;
+    } else {
+        std::cout << "Test Case 6: Passed" << std::endl;
+    }
+
+	err = TestGaitStop();
+    if(err) {
+        std::cout << "Test Case 7: Failed with " << err << std::endl;
+    } else {
+        std::cout << "Test Case 7: Passed" << std::endl;
+    }
+
+	err = TestSettleBaseline();
+    if(err) {
+        std::cout << "Test Case 8: Failed with " << err << std::endl;
+    } else {
+        std::cout << "Test Case 8: Passed" << std::endl;
+    }
+
+	err = TestPromoteAgeLayers();
+    if(err) {
+        std::cout << "Test Case 9: Failed with " << err << std::endl;
+    } else {
+        std::cout << "Test Case 9: Passed" << std::endl;
+    }
+
+	err = TestMigrate();
+    if(err) {
+        std::cout << "Test Case 10: Failed with " << err << std::endl;
+    } else {
+        std::cout << "Test Case 10: Passed" << std::endl;
+    }
+
 	return 0;
 }
\ No newline at end of file
@@ -8,5 +8,14 @@
 std::vector<float> runEvaluator(std::vector<NNRobot> evalBuf);
 
 int TestEvaluator();
+int TestSuccessiveHalving();
+int TestGaitStop();
+int TestSettleBaseline();
+int TestCache();
+int TestPareto();
+int TestSelection();
+int TestBoundedQueue();
+int TestPromoteAgeLayers();
+int TestMigrate();
 
 #endif
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include "opt_tests.h"
+#include "optimizer.h"
+
+#include <algorithm>
+
+// Three ALPS layers of four robots with age limits 2, 4 and unbounded.
+// Robots are told apart by genome hash, new robots have hashes never seen.
+int TestPromoteAgeLayers() {
+    Config::NNRobot nnConfig;
+    nnConfig.massCount = 100;
+    NNRobot::Configure(nnConfig);
+    OptimizerConfig config;
+    config.devo.devo_cycles = 0;
+    Evaluator<NNRobot>::Initialize(config);
+
+    const uint layer_size = 4;
+    auto setup = [&](Optimizer<NNRobot>& O, std::vector<NNRobot>& population,
+                     const std::vector<float>& fitness, const std::vector<uint>& ages) {
+        O.age_gap = 2;
+        population = std::vector<NNRobot>(3 * layer_size);
+        for(size_t i = 0; i < population.size(); i++) {
+            population[i].Randomize();
+            population[i].setFitness(fitness[i]);
+            for(uint a = 0; a < ages[i]; a++) population[i].IncrementAge();
+        }
+        O.subpop_list = std::vector<subpopulation<NNRobot>>(3);
+        for(uint l = 0; l < 3; l++) {
+            auto begin = population.begin() + l * layer_size;
+            O.subpop_list[l] = subpopulation<NNRobot>(begin, begin + layer_size);
+        }
+    };
+    auto hashes = [](const std::vector<NNRobot>& population) {
+        std::vector<uint64_t> h;
+        for(const NNRobot& R : population) h.push_back(R.GenomeHash());
+        return h;
+    };
+    auto isNew = [](const std::vector<uint64_t>& before, const NNRobot& R) {
+        return std::find(before.begin(), before.end(), R.GenomeHash()) == before.end();
+    };
+
+    // Generation 1, no restart. In the bottom layer robot 1 is past its limit
+    // and fitter than the middle layer's worst, robot 3 is past its limit but
+    // less fit and is dropped, robot 2 is at its limit and stays. Middle
+    // robot 4 is past its limit and moves up.
+    {
+        Optimizer<NNRobot> O;
+        std::vector<NNRobot> population;
+        setup(O, population,
+            {9, 8, 7, 1,   5, 4, 3, 2,   20, 19, 18, 1},
+            {0, 3, 2, 5,   5, 0, 0, 0,    9,  9,  9, 9});
+        std::vector<uint64_t> before = hashes(population);
+        if(O.AgeLimit(0) != 2 || O.AgeLimit(1) != 4 || O.AgeLimit(2) != UINT_MAX) return 1;
+
+        O.PromoteAgeLayers(1);
+
+        // middle robot 4 replaced the top layer's worst
+        if(population[11].GenomeHash() != before[4]) return 2;
+        for(uint i = 8; i < 11; i++) if(population[i].GenomeHash() != before[i]) return 3;
+        // bottom robot 1 took the slot robot 4 left
+        if(population[4].GenomeHash() != before[1]) return 4;
+        for(uint i = 5; i < 8; i++) if(population[i].GenomeHash() != before[i]) return 5;
+        // the bottom layer refills both of its emptied slots with random robots
+        if(population[0].GenomeHash() != before[0] || population[2].GenomeHash() != before[2]) return 6;
+        if(!isNew(before, population[1]) || !isNew(before, population[3])) return 7;
+        if(population[1].age() != 0 || population[3].age() != 0) return 8;
+        // robot 3 is gone
+        for(const NNRobot& R : population) if(R.GenomeHash() == before[3]) return 9;
+    }
+
+    // Generation 2 restarts the bottom layer after promotion. Middle robot 5
+    // moves up, bottom robot 0 still takes the slot it left, and every
+    // bottom slot gets a random robot.
+    {
+        Optimizer<NNRobot> O;
+        std::vector<NNRobot> population;
+        setup(O, population,
+            {9, 8, 7, 6,   5, 4, 3, 2,   20, 19, 18, 1},
+            {3, 0, 0, 0,   0, 5, 0, 0,    9,  9,  9, 9});
+        std::vector<uint64_t> before = hashes(population);
+
+        O.PromoteAgeLayers(2);
+
+        if(population[11].GenomeHash() != before[5]) return 10;
+        if(population[5].GenomeHash() != before[0]) return 11;
+        for(uint i = 0; i < layer_size; i++) {
+            if(!isNew(before, population[i])) return 12;
+            if(population[i].age() != 0) return 13;
+        }
+        for(uint i : {4, 6, 7, 8, 9, 10}) if(population[i].GenomeHash() != before[i]) return 14;
+    }
+
+    return 0;
+}
@@ -0,0 +1,42 @@
+#include "opt_tests.h"
+#include "lru_cache.h"
+
+int TestCache() {
+    util::LRUCache<uint64_t, float> cache(2);
+    float value;
+
+    cache.put(1, 1.0f);
+    cache.put(2, 2.0f);
+    if(!cache.get(1, value) || value != 1.0f) return 1;
+
+    // 2 is now least recently used
+    cache.put(3, 3.0f);
+    if(cache.get(2, value)) return 2;
+    if(!cache.get(3, value) || value != 3.0f) return 3;
+    if(cache.size() != 2) return 4;
+    if(cache.hits() != 2 || cache.misses() != 1) return 5;
+
+    util::LRUCache<uint64_t, float> disabled(0);
+    disabled.put(1, 1.0f);
+    if(disabled.get(1, value) || disabled.misses() != 0) return 6;
+
+    Config::NNRobot nnConfig;
+    nnConfig.massCount = 100;
+    NNRobot::Configure(nnConfig);
+
+    NNRobot R;
+    R.Randomize();
+    NNRobot copy(R);
+    if(R.GenomeHash() != copy.GenomeHash()) return 7;
+    copy.Mutate();
+    if(R.GenomeHash() == copy.GenomeHash()) return 8;
+
+    // a restored phenotype matches the build it came from
+    R.Build();
+    NNRobot restored(copy);
+    restored.setPhenotype(R.getPhenotype());
+    if(restored.getMasses().size() != R.getMasses().size()) return 9;
+    if(restored.getSprings().size() != R.getSprings().size()) return 10;
+
+    return 0;
+}
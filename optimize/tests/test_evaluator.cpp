@@ -12,6 +12,8 @@
 #include <iostream>
 #include <string>
 #include <sys/stat.h>
+#include <cmath>
+#include <algorithm>
 
 #include "opt_tests.h"
 
@@ -111,4 +113,141 @@ int TestEvaluator() {
     }
 
 	return successflag;
-}
\ No newline at end of file
+}
+
+// Random robots built for the early stopping tests, evaluated for the
+// full length after a short baseline and without devo
+static std::vector<NNRobot> earlyStopFixture(OptimizerConfig& config) {
+	config.evaluator.pop_size = ROBO_COUNT;
+	config.evaluator.base_time = 1.0f;
+	config.evaluator.eval_time = SIM_TIME;
+	config.devo.devo_cycles = 0;
+
+	std::vector<NNRobot> population(ROBO_COUNT);
+	for(auto& R : population) {
+		R.Randomize();
+	}
+	NNRobot::BatchBuild(population);
+	return population;
+}
+
+// Robots kept through every rung are repacked twice and must score as in
+// one full length simulation, robots dropped early never score above them
+int TestSuccessiveHalving() {
+	OptimizerConfig config;
+	std::vector<NNRobot> population = earlyStopFixture(config);
+
+	Evaluator<NNRobot>::Initialize(config);
+	std::vector<float> full_fitness = runEvaluator(population);
+
+	config.evaluator.rungs = 3;
+	config.evaluator.rung_keep = 0.5f;
+	Evaluator<NNRobot>::Initialize(config);
+	std::vector<NNRobot> evalBuf(population);
+	Evaluator<NNRobot>::BatchEvaluate(evalBuf);
+
+	int successflag = 0;
+	uint finished_count = 0;
+	float lowest_finished = INFINITY;
+	for(uint i = 0; i < ROBO_COUNT; i++) {
+		float fitness = evalBuf[i].fitness();
+		printf("%f vs %f%s\n", full_fitness[i], fitness, evalBuf[i].fitnessEstimated() ? " (estimated)" : "");
+		if(evalBuf[i].fitnessEstimated()) continue;
+		finished_count++;
+		lowest_finished = std::min(lowest_finished, fitness);
+		if(std::abs(full_fitness[i] - fitness) > 1e-4f * std::max(1.0f, std::abs(full_fitness[i]))) successflag += 1;
+	}
+	// 8 -> 4 -> 2 robots
+	if(finished_count != ROBO_COUNT / 4) successflag += 1;
+
+	for(uint i = 0; i < ROBO_COUNT; i++) {
+		if(evalBuf[i].fitnessEstimated() && evalBuf[i].fitness() > lowest_finished) successflag += 1;
+	}
+	return successflag;
+}
+
+// Turns every mass and spring to bone, leaving a robot with no muscles
+static void makePassive(NNRobot& R) {
+	for(Mass& m : R.masses) {
+		if(m.material != materials::air) m.material = materials::bone;
+	}
+	for(Spring& s : R.springs) {
+		if(s.material != materials::air) s.material = materials::bone;
+	}
+}
+
+// Robots stopped on a repeating gait are flagged and extrapolate close to
+// their full length fitness. The first robot is made all bone, so it comes
+// to rest and stops, and the others are repacked without it: those that
+// keep running must score as in a full run.
+int TestGaitStop() {
+	OptimizerConfig config;
+	std::vector<NNRobot> population = earlyStopFixture(config);
+	makePassive(population[0]);
+
+	Evaluator<NNRobot>::Initialize(config);
+	std::vector<float> full_fitness = runEvaluator(population);
+
+	config.evaluator.gait_stop = true;
+	Evaluator<NNRobot>::Initialize(config);
+	std::vector<NNRobot> evalBuf(population);
+	Evaluator<NNRobot>::BatchEvaluate(evalBuf);
+
+	int successflag = 0;
+	for(uint i = 0; i < ROBO_COUNT; i++) {
+		float fitness = evalBuf[i].fitness();
+		printf("%f vs %f%s\n", full_fitness[i], fitness, evalBuf[i].fitnessEstimated() ? " (estimated)" : "");
+		float diff = std::abs(full_fitness[i] - fitness);
+		if(evalBuf[i].fitnessEstimated()) {
+			if(diff > 0.05f * std::max(1.0f, std::abs(full_fitness[i]))) successflag += 1;
+		} else if(diff > 1e-4f * std::max(1.0f, std::abs(full_fitness[i]))) {
+			successflag += 1;
+		}
+	}
+	if(!evalBuf[0].fitnessEstimated()) successflag += 1;
+	return successflag;
+}
+
+// A robot without muscles comes to rest and ends its baseline early, an
+// actuated one keeps moving through the whole baseline. Robots that settle
+// at their first check score exactly as robots that never settle within a
+// baseline of that length.
+int TestSettleBaseline() {
+	OptimizerConfig config;
+	std::vector<NNRobot> population = earlyStopFixture(config);
+	makePassive(population[0]);
+	config.evaluator.settle = true;
+	config.evaluator.base_time = 5.0f;
+	config.evaluator.settle_strain = 0.05f;
+	Evaluator<NNRobot>::Initialize(config);
+
+	int successflag = 0;
+	std::vector<Element> elements = {population[0], population[1]};
+	Evaluator<NNRobot>::Sim.Reset();
+	std::vector<ElementTracker> trackers = Evaluator<NNRobot>::Sim.SetElements(elements);
+	std::vector<float> ended = Evaluator<NNRobot>::SettleBaseline(elements, trackers);
+	printf("still robot settled after %f s, moving robot after %f s\n", ended[0], ended[1]);
+	if(ended[0] >= config.evaluator.base_time) successflag += 1;
+	if(ended[1] < config.evaluator.base_time) successflag += 1;
+
+	config.evaluator.settle_window = 0.5f;
+	config.evaluator.base_time = config.evaluator.settle_window;
+	config.evaluator.settle_energy = -1.0f;
+	config.evaluator.settle_strain = -1.0f;
+	Evaluator<NNRobot>::Initialize(config);
+	std::vector<float> restless_fitness = runEvaluator(population);
+
+	config.evaluator.base_time = 5.0f;
+	config.evaluator.settle_energy = INFINITY;
+	config.evaluator.settle_strain = INFINITY;
+	Evaluator<NNRobot>::Initialize(config);
+	std::vector<float> settled_fitness = runEvaluator(population);
+
+	for(uint i = 0; i < ROBO_COUNT; i++) {
+		printf("%f vs %f\n", restless_fitness[i], settled_fitness[i]);
+		if(std::abs(restless_fitness[i] - settled_fitness[i]) > 1e-4f * std::max(1.0f, std::abs(restless_fitness[i]))) {
+			successflag += 1;
+		}
+	}
+	return successflag;
+}
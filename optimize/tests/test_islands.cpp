@@ -0,0 +1,88 @@
+#include "opt_tests.h"
+#include "optimizer.h"
+
+#include <algorithm>
+
+// Three islands of five robots, all of age 0 so the pareto order is the
+// fitness order. Robots are told apart by genome hash.
+int TestMigrate() {
+    Config::NNRobot nnConfig;
+    nnConfig.massCount = 100;
+    NNRobot::Configure(nnConfig);
+    OptimizerConfig config;
+    config.devo.devo_cycles = 0;
+    Evaluator<NNRobot>::Initialize(config);
+
+    const uint island_count = 3;
+    const uint island_size = 5;
+    const std::vector<float> fitness = {50, 40, 30, 20, 10,   45, 35, 25, 15, 5,   60, 12, 11, 3, 2};
+
+    Optimizer<NNRobot> O;
+    O.migrant_count = 2;
+    std::vector<NNRobot> population(island_count * island_size);
+    for(size_t i = 0; i < population.size(); i++) {
+        population[i].Randomize();
+        population[i].setFitness(fitness[i]);
+    }
+    O.subpop_list = std::vector<subpopulation<NNRobot>>(island_count);
+    for(uint l = 0; l < island_count; l++) {
+        auto begin = population.begin() + l * island_size;
+        O.subpop_list[l] = subpopulation<NNRobot>(begin, begin + island_size);
+    }
+
+    std::vector<uint64_t> before;
+    for(const NNRobot& R : population) before.push_back(R.GenomeHash());
+    auto islandHashes = [&](uint l) {
+        std::vector<uint64_t> h;
+        for(const NNRobot& R : O.subpop_list[l]) h.push_back(R.GenomeHash());
+        std::sort(h.begin(), h.end());
+        return h;
+    };
+    auto islandSorted = [&](uint l) {
+        subpopulation<NNRobot>& island = O.subpop_list[l];
+        for(size_t i = 0; i+1 < island.size(); i++) {
+            if(island[i] < island[i+1]) return false;
+        }
+        return true;
+    };
+
+    O.Migrate();
+
+    for(uint l = 0; l < island_count; l++) {
+        // an island keeps its best size-migrant_count robots and takes
+        // copies of the previous island's top migrant_count
+        uint source = (l + island_count - 1) % island_count;
+        std::vector<uint64_t> expected;
+        for(uint k = 0; k < island_size - O.migrant_count; k++) expected.push_back(before[l * island_size + k]);
+        for(uint k = 0; k < O.migrant_count; k++) expected.push_back(before[source * island_size + k]);
+        std::sort(expected.begin(), expected.end());
+        if(islandHashes(l) != expected) return 1;
+        if(!O.subpop_list[l].admissionBuffer.empty()) return 2;
+        if(!islandSorted(l)) return 3;
+    }
+    // migrants keep their fitness
+    if(population[0].GenomeHash() != before[10] || population[0].fitness() != 60.0f) return 4;
+
+    // Unsort one island, then rank across islands
+    std::swap(population[5], population[9]);
+    std::vector<std::vector<uint64_t>> islands;
+    for(uint l = 0; l < island_count; l++) islands.push_back(islandHashes(l));
+
+    std::vector<uint32_t> ranking = O.RankPopulation(population, true);
+
+    for(uint l = 0; l < island_count; l++) {
+        if(islandHashes(l) != islands[l]) return 5;
+        if(!islandSorted(l)) return 6;
+    }
+    std::vector<uint32_t> indices(ranking);
+    std::sort(indices.begin(), indices.end());
+    for(uint32_t i = 0; i < indices.size(); i++) {
+        if(indices[i] != i) return 7;
+    }
+    for(size_t r = 0; r+1 < ranking.size(); r++) {
+        if(population[ranking[r]].fitness() < population[ranking[r+1]].fitness()) return 8;
+        if(population[ranking[r]] < population[ranking[r+1]]) return 9;
+    }
+
+    return 0;
+}
@@ -0,0 +1,65 @@
+#include "opt_tests.h"
+#include "pareto.h"
+
+// Layers from repeated all-pairs scans, as pareto_classify used to do
+std::vector<uint> ReferenceLayers(const std::vector<float>& obj, size_t dims) {
+    size_t count = obj.size() / dims;
+    std::vector<uint> layers(count, 0);
+    for(uint run = 0; ; run++) {
+        int delta = 0;
+        for(size_t i = 0; i < count; i++) {
+            if(layers[i] < run) continue;
+            for(size_t j = 0; j < count; j++) {
+                if(layers[j] < run || i == j) continue;
+                if(pareto::Dominates(&obj[dims*j], &obj[dims*i], dims)) {
+                    layers[i]++;
+                    delta++;
+                    break;
+                }
+            }
+        }
+        if(delta == 0) break;
+    }
+    return layers;
+}
+
+int TestPareto() {
+    std::vector<uint> layers;
+    for(size_t dims : {2, 3}) {
+        for(uint trial = 0; trial < 200; trial++) {
+            // few distinct values so ties and duplicates are common
+            size_t count = 1 + rand() % 300;
+            int levels = 2 + trial % 20;
+            std::vector<float> obj(count * dims);
+            for(float& o : obj) o = (float) (rand() % levels);
+
+            std::vector<uint> expected = ReferenceLayers(obj, dims);
+            pareto::Classify(obj, dims, layers);
+            if(layers != expected) return dims == 2 ? 1 : 2;
+
+            if(dims == 2) {
+                pareto::ClassifyGeneral(obj.data(), count, dims, layers.data());
+                if(layers != expected) return 3;
+            }
+        }
+    }
+
+    // fitness and negated age of a population
+    std::vector<NNRobot> robots(50);
+    for(NNRobot& R : robots) {
+        R.setFitness((float) (rand() % 10));
+        for(int a = rand() % 5; a > 0; a--) R.IncrementAge();
+    }
+    std::vector<float> obj(robots.size() * 2);
+    for(size_t i = 0; i < robots.size(); i++) robots[i].objectives(&obj[2*i]);
+    std::vector<uint> expected = ReferenceLayers(obj, 2);
+    Evaluator<NNRobot>::pareto_classify(robots.begin(), robots.end());
+    for(size_t i = 0; i < robots.size(); i++) {
+        if(robots[i].paretoLayer() != expected[i]) return 4;
+        for(size_t j = 0; j < robots.size(); j++) {
+            if(robots[j].dominates(robots[i]) != pareto::Dominates(&obj[2*j], &obj[2*i], 2)) return 5;
+        }
+    }
+
+    return 0;
+}
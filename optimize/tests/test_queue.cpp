@@ -0,0 +1,51 @@
+#include "opt_tests.h"
+#include "bounded_queue.h"
+#include <atomic>
+#include <thread>
+
+// Every pushed item is popped exactly once, producers never overrun the
+// capacity, and closing wakes blocked producers and drains the rest
+int TestBoundedQueue() {
+    const uint producers = 3, per_producer = 1000, capacity = 16, batch = 10;
+    util::BoundedQueue<uint> queue(capacity);
+
+    std::atomic<uint> refused(0);
+    std::vector<std::thread> threads;
+    for(uint p = 0; p < producers; p++) {
+        threads.emplace_back([&, p]() {
+            for(uint i = 0; i < per_producer; i++) {
+                if(!queue.Push(p * per_producer + i)) refused++;
+            }
+        });
+    }
+
+    std::vector<uint> seen(producers * per_producer, 0);
+    std::vector<uint> items;
+    uint popped = 0;
+    while(popped < producers * per_producer) {
+        items.clear();
+        size_t taken = queue.PopBatch(items, batch);
+        if(taken != batch) return 1;
+        if(queue.size() > capacity) return 2;
+        for(uint item : items) seen[item]++;
+        popped += taken;
+    }
+    for(uint s : seen) if(s != 1) return 3;
+
+    // a producer blocked on a full queue is released by Close
+    for(uint i = 0; i < capacity; i++) queue.Push(i);
+    std::thread blocked([&]() { if(!queue.Push(0)) refused++; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    queue.Close();
+    blocked.join();
+    for(std::thread& t : threads) t.join();
+    if(refused != 1) return 4;
+
+    // after closing, PopBatch returns what is left without waiting
+    items.clear();
+    if(queue.PopBatch(items, capacity + 4) != capacity) return 5;
+    if(queue.PopBatch(items, batch) != 0) return 6;
+    if(queue.Push(1)) return 7;
+
+    return 0;
+}
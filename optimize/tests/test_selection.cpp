@@ -0,0 +1,59 @@
+#include "opt_tests.h"
+#include "selection.h"
+#include <cmath>
+
+// Draw frequencies match the target distribution of each strategy
+int TestSelection() {
+    std::mt19937 rng(75);
+    const uint draws = 200000;
+
+    auto frequencies = [&](const selection::Selector& selector, size_t count) {
+        std::vector<float> freq(count, 0.0f);
+        for(uint d = 0; d < draws; d++) freq[selector.Sample(rng)] += 1.0f / draws;
+        return freq;
+    };
+
+    // roulette, proportional to fitness
+    std::vector<float> fitness = {0.0f, 1.0f, 2.0f, 3.0f, 4.0f, 0.5f, 0.0f, 1.5f};
+    float total = 12.0f;
+    selection::Selector roulette(SELECT_ROULETTE);
+    roulette.Prepare(fitness);
+    std::vector<float> freq = frequencies(roulette, fitness.size());
+    for(size_t i = 0; i < fitness.size(); i++) {
+        if(std::abs(freq[i] - fitness[i] / total) > 0.01f) return 1;
+    }
+    if(freq[0] != 0.0f || freq[6] != 0.0f) return 2;
+
+    // roulette with no fitness anywhere is uniform
+    selection::Selector flat(SELECT_ROULETTE);
+    flat.Prepare(std::vector<float>(4, 0.0f));
+    freq = frequencies(flat, 4);
+    for(float f : freq) if(std::abs(f - 0.25f) > 0.01f) return 3;
+
+    // rank, proportional to n - rank
+    selection::Selector rank(SELECT_RANK);
+    std::vector<float> ranked = {-5.0f, 10.0f, 3.0f, 7.0f};
+    rank.Prepare(ranked);
+    freq = frequencies(rank, ranked.size());
+    float expected[4] = {1.0f/10, 4.0f/10, 2.0f/10, 3.0f/10};
+    for(size_t i = 0; i < ranked.size(); i++) {
+        if(std::abs(freq[i] - expected[i]) > 0.01f) return 4;
+    }
+
+    // tournament of k: the worst of n only wins when drawn k times
+    selection::Selector tournament(SELECT_TOURNAMENT, 2);
+    tournament.Prepare(ranked);
+    freq = frequencies(tournament, ranked.size());
+    if(std::abs(freq[0] - 1.0f/16) > 0.01f) return 5;
+    if(std::abs(freq[1] - 7.0f/16) > 0.01f) return 6;
+
+    // pairs are distinct even when one robot holds all the weight
+    selection::Selector single(SELECT_ROULETTE);
+    single.Prepare({0.0f, 0.0f, 9.0f});
+    for(uint d = 0; d < 1000; d++) {
+        std::pair<size_t, size_t> pair = single.SamplePair(rng);
+        if(pair.first != 2 || pair.second == pair.first) return 7;
+    }
+
+    return 0;
+}
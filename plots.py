@@ -105,6 +105,34 @@ def plotDiversity(filepath):
     plt.xlabel("Evaluations")
     plt.savefig(f"{filepath}/div_plot.png")
 
+# Benchmark thread/batch scaling (benchmark scaling)
+def plotScaling(filepath):
+    scaling = pd.read_csv(f"{filepath}/scaling.csv")
+    scaling.rename(columns=lambda x: x.strip(),inplace=True)
+    print(scaling)
+
+    for size in scaling['size'].unique():
+        data = scaling[scaling['size']==size]
+        robot = data['robot'].iloc[0].strip()
+
+        plt.figure()
+        sns.lineplot(data=data, x="threads", y='throughput', hue='batch', marker='o', palette='viridis')
+        plt.xscale("log", base=2)
+        plt.yscale("log")
+        plt.title(f"Throughput ({robot}, size {size})")
+        plt.ylabel("Springs x Steps / s")
+        plt.xlabel("Threads")
+        plt.savefig(f"{filepath}/scaling_throughput_{size}.png")
+
+        plt.figure()
+        sns.lineplot(data=data, x="threads", y='efficiency', hue='batch', marker='o', palette='viridis')
+        plt.xscale("log", base=2)
+        plt.ylim([0,1.1])
+        plt.title(f"Parallel Efficiency ({robot}, size {size})")
+        plt.ylabel("Efficiency")
+        plt.xlabel("Threads")
+        plt.savefig(f"{filepath}/scaling_efficiency_{size}.png")
+
 if __name__ == "__main__":
     # TODO: ingest filepath so we can call from evodevo
     filepath1 = "/path/to/z_results/evo_run_folder"